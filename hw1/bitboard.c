@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "bitboard.h"
+
+void bitboardInit(bitboard *bits, int width, int height) {
+    bits->width = width;
+    bits->height = height;
+    bits->words = (width + height - 1 + 63) / 64;
+
+    size_t count = (size_t)height * bits->words;
+    bits->rows = calloc(count, sizeof(uint64_t));
+    bits->rising = calloc(count, sizeof(uint64_t));
+    bits->falling = calloc(count, sizeof(uint64_t));
+    bits->scratch = calloc(count, sizeof(uint64_t));
+}
+
+void bitboardFree(bitboard *bits) {
+    free(bits->rows);
+    free(bits->rising);
+    free(bits->falling);
+    free(bits->scratch);
+}
+
+void bitboardClear(bitboard *bits) {
+    size_t size = (size_t)bits->height * bits->words * sizeof(uint64_t);
+    memset(bits->rows, 0, size);
+    memset(bits->rising, 0, size);
+    memset(bits->falling, 0, size);
+}
+
+static inline void setBit(uint64_t *row, int bit) {
+    row[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+void bitboardSet(bitboard *bits, int x, int y) {
+    size_t row = (size_t)y * bits->words;
+    setBit(bits->rows + row, x);
+    setBit(bits->rising + row, x + y);
+    setBit(bits->falling + row, x + bits->height - 1 - y);
+}
+
+// data[i] &= data[i + offset] for i < count, ascending so data[i + offset] is still unchanged
+static void andShifted(uint64_t *data, size_t count, size_t offset) {
+    size_t i = 0;
+
+#ifdef __AVX2__
+    // four words per step, the wide rows of big boards
+    for (; i + 4 <= count; i += 4) {
+        __m256i here = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i there = _mm256_loadu_si256((const __m256i *)(data + i + offset));
+        _mm256_storeu_si256((__m256i *)(data + i), _mm256_and_si256(here, there));
+    }
+#endif
+
+    for (; i < count; i++) {
+        data[i] &= data[i + offset];
+    }
+}
+
+static int anySet(const uint64_t *data, size_t count) {
+    uint64_t any = 0;
+    for (size_t i = 0; i < count; i++) {
+        any |= data[i];
+    }
+    return any != 0;
+}
+
+// column runs of one view: AND each row with the rows below it
+static int columnStreak(bitboard *bits, const uint64_t *view, int streakSize) {
+    int height = bits->height;
+    size_t words = bits->words;
+    uint64_t *rows = bits->scratch;
+
+    if (streakSize > height) {
+        return 0;
+    }
+    memcpy(rows, view, height * words * sizeof(uint64_t));
+
+    // rows[y] is the AND of rows y .. y+length-1, valid for y <= height - length
+    int length = 1;
+    while (length * 2 <= streakSize) {
+        andShifted(rows, (height - 2 * length + 1) * words, length * words);
+        length *= 2;
+    }
+    if (length < streakSize) {
+        andShifted(rows, (height - streakSize + 1) * words, (streakSize - length) * words);
+    }
+    return anySet(rows, (height - streakSize + 1) * words);
+}
+
+// row[i] &= row >> shift, bit x keeps whether bit x + shift was set too
+static void andShiftRight(uint64_t *row, int words, int shift) {
+    int wordShift = shift / 64;
+    int bitShift = shift % 64;
+
+    for (int i = 0; i < words; i++) {
+        uint64_t shifted = 0;
+        if (i + wordShift < words) {
+            shifted = row[i + wordShift] >> bitShift;
+            if (bitShift && i + wordShift + 1 < words) {
+                shifted |= row[i + wordShift + 1] << (64 - bitShift);
+            }
+        }
+        row[i] &= shifted;
+    }
+}
+
+// row runs: shift-AND inside each row
+static int rowStreak(bitboard *bits, int streakSize) {
+    int words = bits->words;
+
+    if (streakSize > bits->width) {
+        return 0;
+    }
+
+    for (int y = 0; y < bits->height; y++) {
+        uint64_t *row = bits->scratch;
+        memcpy(row, bits->rows + (size_t)y * words, words * sizeof(uint64_t));
+
+        // bit x is the AND of bits x .. x+length-1
+        int length = 1;
+        while (length * 2 <= streakSize) {
+            andShiftRight(row, words, length);
+            length *= 2;
+        }
+        if (length < streakSize) {
+            andShiftRight(row, words, streakSize - length);
+        }
+        if (anySet(row, words)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int bitboardHasStreak(bitboard *bits, int streakSize) {
+    if (streakSize <= 0) {
+        return 1;
+    }
+    return rowStreak(bits, streakSize) ||
+           columnStreak(bits, bits->rows, streakSize) ||
+           columnStreak(bits, bits->rising, streakSize) ||
+           columnStreak(bits, bits->falling, streakSize);
+}
@@ -0,0 +1,39 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+
+/*
+bitboard of one player, for checking whole board states at once
+(replay validation, analytics), not for the per move check in the server.
+
+three views, every row packed into 64 bit words:
+  rows     bit x of row y is cell (x, y)
+  rising   row y shifted left by y, left down to right up diagonals become columns
+  falling  row y shifted left by height-1-y, left up to right down diagonals become columns
+a row run is found with shift-AND inside each row, a column run with AND
+across consecutive rows, which is how the column and both diagonals are checked.
+both double the run length per step, log2(streak_size) passes over the board
+*/
+
+typedef struct bitboard {
+    int width;
+    int height;
+    int words;              // words per row, enough for width + height - 1 bits
+    uint64_t *rows;
+    uint64_t *rising;
+    uint64_t *falling;
+    uint64_t *scratch;      // height * words, work area of the checks
+} bitboard;
+
+void bitboardInit(bitboard *bits, int width, int height);
+void bitboardFree(bitboard *bits);
+void bitboardClear(bitboard *bits);
+
+// set cell, position must be inside the board
+void bitboardSet(bitboard *bits, int x, int y);
+
+// 1 if there are streakSize set cells in a row, column or diagonal
+int bitboardHasStreak(bitboard *bits, int streakSize);
+
+#endif
@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+
+#define BOARD_ALIGN 64
+
+void boardInit(board *myBoard, int width, int height) {
+    myBoard->memory = NULL;
+    myBoard->memorySize = 0;
+    boardReset(myBoard, width, height);
+}
+
+void boardReset(board *myBoard, int width, int height) {
+    myBoard->width = width;
+    myBoard->height = height;
+
+    // one border cell on each side, rounded up to 16 bytes
+    myBoard->stride = (width + 2 + 15) & ~15;
+
+    // border row above and below
+    size_t size = (size_t)myBoard->stride * (height + 2);
+    size = (size + BOARD_ALIGN - 1) / BOARD_ALIGN * BOARD_ALIGN;
+    if (size > myBoard->memorySize) {
+        free(myBoard->memory);
+        myBoard->memory = aligned_alloc(BOARD_ALIGN, size);
+        myBoard->memorySize = size;
+    }
+    memset(myBoard->memory, BOARD_BORDER, size);
+
+    myBoard->cells = myBoard->memory + myBoard->stride + 1;
+    for (int h = 0; h < height; h++) {
+        memset(myBoard->cells + boardIndex(myBoard, 0, h), BOARD_EMPTY, width);
+    }
+}
+
+void boardFree(board *myBoard) {
+    free(myBoard->memory);
+    myBoard->memory = NULL;
+    myBoard->memorySize = 0;
+    myBoard->cells = NULL;
+}
+
+int boardMark(board *myBoard, int x, int y, char character) {
+    // bounds first, then the cell
+    if (!boardInside(myBoard, x, y)) {
+        return 0;
+    }
+
+    char *cell = &myBoard->cells[boardIndex(myBoard, x, y)];
+    if (*cell != BOARD_EMPTY) {
+        return 0;
+    }
+    *cell = character;
+    return 1;
+}
@@ -0,0 +1,50 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+/*
+game board in one contiguous buffer
+rows are padded to a 16 byte stride and surrounded by border cells,
+so walking off any edge lands on BOARD_BORDER instead of outside memory.
+neighbor of index i in any direction is i + step, no edge checks needed
+*/
+
+#define BOARD_EMPTY '.'
+#define BOARD_BORDER '#'
+
+typedef struct board {
+    int width;
+    int height;
+    int stride;         // distance between rows, at least width + 2
+    char *memory;       // allocation, starts with a border row
+    size_t memorySize;
+    char *cells;        // cell (0, 0)
+} board;
+
+void boardInit(board *myBoard, int width, int height);
+void boardFree(board *myBoard);
+
+// empty board of a new size, memory is kept if it is large enough
+void boardReset(board *myBoard, int width, int height);
+
+// position check, always do it before indexing
+static inline int boardInside(const board *myBoard, int x, int y) {
+    return x >= 0 && x < myBoard->width && y >= 0 && y < myBoard->height;
+}
+
+// index relative to cells, border cells have indices too
+static inline int boardIndex(const board *myBoard, int x, int y) {
+    return y * myBoard->stride + x;
+}
+
+// character at a position, border outside the board
+static inline char boardGet(const board *myBoard, int x, int y) {
+    if (!boardInside(myBoard, x, y)) {
+        return BOARD_BORDER;
+    }
+    return myBoard->cells[boardIndex(myBoard, x, y)];
+}
+
+// mark an empty cell inside the board, returns 1 if marked
+int boardMark(board *myBoard, int x, int y, char character);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef GAME_PROTOCOL_H
+#define GAME_PROTOCOL_H
+
+#include "game_structs.h"
+
+/*
+client message types after START and MARK of game_structs.h
+
+START_DELTA  like START, the reply has the whole grid data.
+             after it every RESULT has filled_count as the total as before,
+             but only carries the gd entries added since the previous reply
+             to this player (filled_count minus what the player already has).
+RESYNC       player lost track, reply with the whole grid data again.
+             the player stays in the mode it started with
+
+server message types after RESULT and END
+
+RESET        only with the player pool (server -p). a player stays connected
+             after END; RESET means a new game begins and the player starts
+             over by sending START or START_DELTA. end of file instead means
+             the server is done and the player exits. a player that
+             exits on END anyway is started again when its next game
+             reads end of file instead of START.
+             messages the player sent before RESET, e.g. marks pipelined
+             behind the winning one, are dropped until its START arrives
+*/
+
+#define START_DELTA 2
+#define RESYNC 3
+
+#define RESET 2
+
+#endif
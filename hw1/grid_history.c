@@ -0,0 +1,47 @@
+#include <stdlib.h>
+
+#include "grid_history.h"
+
+static void reserve(gridHistory *history, int capacity) {
+    history->entries = realloc(history->entries, capacity * sizeof(gd));
+    history->capacity = capacity;
+
+    history->allocations++;
+    history->allocatedBytes += capacity * sizeof(gd);
+}
+
+void gridHistoryInit(gridHistory *history, int capacity) {
+    history->entries = NULL;
+    history->count = 0;
+    history->capacity = 0;
+    history->allocations = 0;
+    history->allocatedBytes = 0;
+
+    reserve(history, capacity > 0 ? capacity : 1);
+}
+
+void gridHistoryReset(gridHistory *history, int capacity) {
+    history->count = 0;
+    if (capacity > history->capacity) {
+        reserve(history, capacity);
+    }
+}
+
+void gridHistoryFree(gridHistory *history) {
+    free(history->entries);
+    history->entries = NULL;
+    history->count = 0;
+    history->capacity = 0;
+}
+
+gd *gridHistoryAppend(gridHistory *history, int x, int y, char character) {
+    if (history->count == history->capacity) {
+        reserve(history, history->capacity * 2);
+    }
+
+    gd *entry = &history->entries[history->count++];
+    entry->position.x = x;
+    entry->position.y = y;
+    entry->character = character;
+    return entry;
+}
@@ -0,0 +1,32 @@
+#ifndef GRID_HISTORY_H
+#define GRID_HISTORY_H
+
+#include "game_structs.h"
+
+/*
+marks of the game in order, the gd array sent to players
+reserved for the whole board up front, a cell is marked at most once,
+so appending never allocates and entries never move during a game.
+grows geometrically if a caller reserves too little
+*/
+
+typedef struct gridHistory {
+    gd *entries;
+    int count;
+    int capacity;
+
+    // allocation counters, to check that moves do not allocate
+    int allocations;            // malloc and realloc calls
+    long allocatedBytes;
+} gridHistory;
+
+void gridHistoryInit(gridHistory *history, int capacity);
+void gridHistoryFree(gridHistory *history);
+
+// empty history for the next game, entries are kept if capacity is enough
+void gridHistoryReset(gridHistory *history, int capacity);
+
+// append a mark, returns its entry
+gd *gridHistoryAppend(gridHistory *history, int x, int y, char character);
+
+#endif
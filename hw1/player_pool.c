@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "game_protocol.h"
+#include "player_pool.h"
+
+int spawnPlayer(char **arguments, int *serverFd) {
+    *serverFd = -1;
+
+    // close-on-exec, other players must not inherit the socket
+    int fd[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, PF_UNIX, fd) < 0) {
+        perror("socketpair");
+        return -1;
+    }
+
+    int pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        // stdin and stdout of the player, dup2 clears close-on-exec
+        dup2(fd[1], 0);
+        dup2(fd[1], 1);
+        close(fd[0]);
+        close(fd[1]);
+
+        execv(arguments[0], arguments);
+        perror("execv");
+        _exit(-1);     // server output buffered before fork is not written twice
+    }
+
+    close(fd[1]);
+
+    // server end never blocks, the event loop waits instead
+    fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
+    *serverFd = fd[0];
+    return pid;
+}
+
+void playerPoolInit(playerPool *pool, int limit) {
+    pool->players = NULL;
+    pool->count = 0;
+    pool->capacity = 0;
+    pool->limit = limit;
+    pool->spawns = 0;
+    pool->resets = 0;
+}
+
+static bool sameArguments(char **a, char **b) {
+    for (; *a != NULL && *b != NULL; a++, b++) {
+        if (strcmp(*a, *b) != 0) {
+            return false;
+        }
+    }
+    return *a == NULL && *b == NULL;
+}
+
+static char **copyArguments(char **arguments) {
+    int count = 0;
+    while (arguments[count] != NULL) {
+        count++;
+    }
+
+    char **copy = malloc((count + 1) * sizeof(char *));
+    for (int i = 0; i < count; i++) {
+        copy[i] = strdup(arguments[i]);
+    }
+    copy[count] = NULL;
+    return copy;
+}
+
+static void freeArguments(char **arguments) {
+    for (int i = 0; arguments[i] != NULL; i++) {
+        free(arguments[i]);
+    }
+    free(arguments);
+}
+
+// closes the socket and waits for the process, it sees end of file
+// an entry whose spawn failed has neither
+static void endPlayer(pooledPlayer *player) {
+    if (player->fd >= 0) {
+        close(player->fd);
+    }
+    if (player->pid > 0) {
+        waitpid(player->pid, NULL, 0);
+    }
+    player->fd = -1;
+    player->pid = -1;
+}
+
+// RESET to an idle player, false if its socket is closed already
+// a player exiting on END may still be on its way out, then the send goes through
+// and the game finds out at end of file, see playerPoolRestart
+static bool resetPlayer(pooledPlayer *player) {
+    // not printed, RESET belongs to the pool and not to a game
+    // the socket is empty: the player read everything up to END
+    sm myServerMessage;
+    myServerMessage.type = RESET;
+    myServerMessage.success = 1;
+    myServerMessage.filled_count = 0;
+
+    ssize_t sent;
+    do {
+        sent = send(player->fd, &myServerMessage, sizeof(sm), MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent != sizeof(sm)) {
+        endPlayer(player);
+        return false;
+    }
+    return true;
+}
+
+int playerPoolAcquire(playerPool *pool, char **arguments) {
+    int index = -1;
+    int idleIndex = -1;     // idle with other arguments, replaced if the pool is full
+    for (int i = 0; i < pool->count; i++) {
+        pooledPlayer *player = &pool->players[i];
+        if (player->isBusy) {
+            continue;
+        }
+        if (!sameArguments(player->arguments, arguments)) {
+            if (idleIndex < 0) {
+                idleIndex = i;
+            }
+            continue;
+        }
+
+        if (player->fd >= 0 && resetPlayer(player)) {
+            player->isBusy = true;
+            pool->resets++;
+            return i;
+        }
+
+        // dead entry, started again below
+        index = i;
+        break;
+    }
+
+    if (index < 0 && pool->count >= pool->limit && idleIndex >= 0) {
+        index = idleIndex;
+        if (pool->players[index].fd >= 0) {
+            endPlayer(&pool->players[index]);
+        }
+        freeArguments(pool->players[index].arguments);
+        pool->players[index].arguments = copyArguments(arguments);
+    }
+
+    if (index < 0) {
+        if (pool->count == pool->capacity) {
+            pool->capacity = pool->capacity ? pool->capacity * 2 : 16;
+            pool->players = realloc(pool->players, pool->capacity * sizeof(pooledPlayer));
+        }
+        index = pool->count++;
+        pool->players[index].arguments = copyArguments(arguments);
+    }
+
+    pooledPlayer *player = &pool->players[index];
+    player->partialLength = 0;
+    player->pid = spawnPlayer(player->arguments, &player->fd);
+    if (player->pid < 0) {
+        // entry stays idle and dead, the next acquire tries again
+        player->isBusy = false;
+        return -1;
+    }
+    player->isBusy = true;
+    pool->spawns++;
+    return index;
+}
+
+bool playerPoolRestart(playerPool *pool, int index) {
+    pooledPlayer *player = &pool->players[index];
+    endPlayer(player);
+
+    // counted as reused in playerPoolAcquire, it was not
+    pool->resets--;
+
+    player->partialLength = 0;
+    player->pid = spawnPlayer(player->arguments, &player->fd);
+    if (player->pid < 0) {
+        return false;
+    }
+    pool->spawns++;
+    return true;
+}
+
+void playerPoolRelease(playerPool *pool, int index, bool isAlive, const char *unread, int unreadLength) {
+    pooledPlayer *player = &pool->players[index];
+    if (!isAlive) {
+        endPlayer(player);
+    }
+
+    // the rest of a cut message is still in the socket, the next game has to see it whole
+    player->partialLength = unreadLength % sizeof(cm);
+    memcpy(player->partial, unread + unreadLength - player->partialLength, player->partialLength);
+    player->isBusy = false;
+}
+
+void playerPoolFree(playerPool *pool) {
+    // every player gets end of file first, then they are reaped
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->players[i].fd >= 0) {
+            close(pool->players[i].fd);
+        }
+    }
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->players[i].fd >= 0 && pool->players[i].pid > 0) {
+            waitpid(pool->players[i].pid, NULL, 0);
+        }
+        freeArguments(pool->players[i].arguments);
+    }
+    free(pool->players);
+    playerPoolInit(pool, pool->limit);
+}
@@ -0,0 +1,66 @@
+#ifndef PLAYER_POOL_H
+#define PLAYER_POOL_H
+
+#include <stdbool.h>
+
+#include "game_structs.h"
+
+/*
+player processes kept between games
+a player started once stays connected after END. when the next game needs
+the same executable with the same arguments, the process gets RESET and
+starts over with START, no fork or exec. processes are matched by their
+whole argument array. a process that exits on END is not known to be gone
+until the next game reads end of file from it before its START; the game
+then has it started again in place. a process whose START a game never
+read is not kept, a START left in its socket would look like an answer to
+RESET. once the pool holds limit processes, a new player replaces an idle
+one with other arguments instead of adding one.
+players have to understand RESET, see game_protocol.h
+*/
+
+typedef struct pooledPlayer {
+    char **arguments;   // own copy, executable path first, NULL at the end
+    int fd;             // server end of the socket, non-blocking
+    int pid;
+    bool isBusy;        // in a running game
+    char partial[sizeof(cm)];   // start of a message the previous game stopped reading in
+    int partialLength;
+} pooledPlayer;
+
+typedef struct playerPool {
+    pooledPlayer *players;
+    int count;
+    int capacity;
+    int limit;          // above this many processes idle ones with other arguments are replaced
+
+    // counters, to see how much reuse a tournament got
+    int spawns;
+    int resets;
+} playerPool;
+
+void playerPoolInit(playerPool *pool, int limit);
+
+// close every socket and reap the players, they exit at end of file
+void playerPoolFree(playerPool *pool);
+
+// player process for a game, an idle one with the same arguments or a new one
+// returns its index, the entry stays in place until released
+// -1 if a new one was needed and could not be started
+int playerPoolAcquire(playerPool *pool, char **arguments);
+
+// player closed its socket before its START in a new game, it had exited at END
+// a new process replaces it, the entry keeps its index and gets a new fd and pid
+// false if it could not be started, the entry is then released like a closed player
+bool playerPoolRestart(playerPool *pool, int index);
+
+// game is over, isAlive false if the player closed its socket (reaped here)
+// unread are the received bytes the game did not take, a cut message at their end is kept
+void playerPoolRelease(playerPool *pool, int index, bool isAlive, const char *unread, int unreadLength);
+
+// fork and exec one player, stdin and stdout are the socket
+// returns the pid, serverFd gets the server end (non-blocking, close-on-exec)
+// -1 and serverFd -1 if the socket or the process could not be made
+int spawnPlayer(char **arguments, int *serverFd);
+
+#endif
@@ -0,0 +1,47 @@
+#!/bin/sh
+# runs the same games with and without the player pool (-p)
+# every player of every game has to reach END in every run
+#
+# end:   test_player exits on END, every pooled process is gone when its
+#        next game sends RESET and has to be started again
+# reset: test_player answers RESET with START, its marks of the previous
+#        game must be dropped and the processes must be reused
+#
+#   ./pool_test.sh [games]
+
+GAMES=${1:-30}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+status=0
+for mode in end reset; do
+    i=0
+    while [ $i -lt $GAMES ]; do
+        echo "8 8 4 2"
+        echo "A 5"
+        echo "./test_player 8 8 1 $DIR/ends $mode"
+        echo "B 5"
+        echo "./test_player 8 8 2 $DIR/ends $mode"
+        i=$((i + 1))
+    done > "$DIR/games"
+
+    for flags in "-j 1" "-j 1 -p" "-j 4 -p"; do
+        rm -f "$DIR/ends"
+        ./server -g - $flags < "$DIR/games" > "$DIR/out" || { echo "$mode, server $flags: exit status $?"; status=1; continue; }
+
+        results=$(grep -c -e "Winner" -e "Draw" "$DIR/out")
+        ends=$(cat "$DIR/ends" 2>/dev/null | wc -l)
+        processes=$(sort -u "$DIR/ends" 2>/dev/null | wc -l)
+        if [ "$results" -ne "$GAMES" ] || [ "$ends" -ne $((2 * GAMES)) ]; then
+            echo "$mode, server $flags: $results of $GAMES games decided, $ends of $((2 * GAMES)) players reached END"
+            status=1
+        elif [ $mode = reset ] && [ "$flags" != "-j 1" ] && [ "$processes" -gt $((GAMES / 2)) ]; then
+            # two per slot at least, a few more when a late START gets a process dropped
+            echo "$mode, server $flags: $processes processes for $GAMES games, pool did not reuse them"
+            status=1
+        else
+            echo "$mode, server $flags: ok, $processes processes"
+        fi
+    done
+done
+exit $status
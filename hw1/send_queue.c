@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "send_queue.h"
+
+#define SEND_IOV_MAX 64     // parts per sendmsg
+
+void sendQueueInit(sendQueue *queue, size_t limit) {
+    queue->parts = NULL;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->capacity = 0;
+    queue->offset = 0;
+    queue->pending = 0;
+    queue->limit = limit;
+}
+
+void sendQueueReset(sendQueue *queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->offset = 0;
+    queue->pending = 0;
+}
+
+void sendQueueFree(sendQueue *queue) {
+    free(queue->parts);
+    sendQueueInit(queue, queue->limit);
+}
+
+void sendQueuePush(sendQueue *queue, const void *data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    if (queue->tail == queue->capacity) {
+        // move the unsent parts to the front before growing
+        if (queue->head > 0) {
+            memmove(queue->parts, queue->parts + queue->head, (queue->tail - queue->head) * sizeof(sendPart));
+            queue->tail -= queue->head;
+            queue->head = 0;
+        }
+        if (queue->tail == queue->capacity) {
+            queue->capacity = queue->capacity ? queue->capacity * 2 : 8;
+            queue->parts = realloc(queue->parts, queue->capacity * sizeof(sendPart));
+        }
+    }
+
+    sendPart *part = &queue->parts[queue->tail++];
+    part->length = length;
+    if (length <= SEND_PART_COPY) {
+        part->data = NULL;
+        memcpy(part->copy, data, length);
+    }
+    else {
+        part->data = data;
+    }
+    queue->pending += length;
+}
+
+static const char *partData(const sendPart *part) {
+    return part->data ? part->data : part->copy;
+}
+
+long sendQueueFlush(sendQueue *queue, int fd) {
+    int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+
+    while (queue->pending > 0) {
+        struct iovec parts[SEND_IOV_MAX];
+        int count = 0;
+
+        for (int p = queue->head; p < queue->tail && count < SEND_IOV_MAX; p++, count++) {
+            size_t skip = (p == queue->head) ? queue->offset : 0;
+            parts[count].iov_base = (char *)partData(&queue->parts[p]) + skip;
+            parts[count].iov_len = queue->parts[p].length - skip;
+        }
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = parts;
+        message.msg_iovlen = count;
+
+        ssize_t sent = sendmsg(fd, &message, flags);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return queue->pending;
+            }
+            // player is gone, nothing will be read anymore
+            queue->head = queue->tail = 0;
+            queue->offset = 0;
+            queue->pending = 0;
+            return -1;
+        }
+
+        // drop what went out, the head part may be partly sent
+        queue->pending -= sent;
+        while (sent > 0) {
+            size_t left = queue->parts[queue->head].length - queue->offset;
+            if ((size_t)sent < left) {
+                queue->offset += sent;
+                break;
+            }
+            sent -= left;
+            queue->offset = 0;
+            queue->head++;
+        }
+    }
+
+    queue->head = queue->tail = 0;
+    queue->offset = 0;
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+output queue of one player
+messages are queued as parts and go out together with one sendmsg per flush,
+so a RESULT header, its grid data and a following END leave in one syscall.
+small parts (message headers) are copied into the queue, large ones are
+referenced, they must stay put until sent: grid history entries do.
+a short write leaves the rest queued, the caller waits for EPOLLOUT.
+the queue is bounded by backpressure, not by dropping: once pending bytes
+reach the limit the caller stops taking requests from that player
+*/
+
+#define SEND_PART_COPY 16       // parts up to this size are copied
+
+typedef struct sendPart {
+    const char *data;           // referenced data, NULL if copied
+    size_t length;
+    char copy[SEND_PART_COPY];
+} sendPart;
+
+typedef struct sendQueue {
+    sendPart *parts;
+    int head;           // first part not fully sent
+    int tail;
+    int capacity;
+    size_t offset;      // bytes of the head part already sent
+    size_t pending;     // bytes waiting
+    size_t limit;       // full at this many pending bytes
+} sendQueue;
+
+void sendQueueInit(sendQueue *queue, size_t limit);
+void sendQueueFree(sendQueue *queue);
+
+// drop everything queued, part array is kept for reuse
+void sendQueueReset(sendQueue *queue);
+
+// queue bytes, copied if small
+void sendQueuePush(sendQueue *queue, const void *data, size_t length);
+
+// send as much as the socket takes without waiting
+// returns bytes still pending, -1 if the player is gone (queue is dropped)
+long sendQueueFlush(sendQueue *queue, int fd);
+
+static inline bool sendQueueEmpty(const sendQueue *queue) {
+    return queue->pending == 0;
+}
+
+static inline bool sendQueueFull(const sendQueue *queue) {
+    return queue->pending >= queue->limit;
+}
+
+#endif
@@ -3,13 +3,26 @@
 #include <stdlib.h>
 #include <sys/socket.h>
 #include <stdbool.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <errno.h>
+#include <string.h>
 #include <sys/wait.h>
 
 #include "game_structs.h"
 #include "print_output.h"
-
-#define PIPE(fd) socketpair(AF_UNIX, SOCK_STREAM, PF_UNIX, fd)
+#include "board.h"
+#include "streak.h"
+#include "bitboard.h"
+#include "game_protocol.h"
+#include "grid_history.h"
+#include "send_queue.h"
+#include "player_pool.h"
+
+#define MAX_EVENTS 64   // ready players handled per epoll_wait
+#define INBOX_SIZE (64 * sizeof(cm))    // received bytes buffered per player
+#define OUTPUT_LIMIT (1 << 20)          // queued reply bytes before a player's requests wait
+#define DEFAULT_SLOTS 16                // games run at the same time with -g
+#define POOL_LIMIT 256                  // player processes kept with -p
 
 /*This setup allows for bidirectional communication, where each end of the pipe can read and write
 data.
@@ -72,51 +85,245 @@ Understanding select - Code Example
 */
 
 //debug print grid
-void printGrid(char** myGrid, int height, int width){
+void printGrid(board* myBoard){
     printf("current grid state\n");
-    for (int h=0; h <height; h++) {
-        for (int w =0; w < width; w++) {
-            printf("%c ", myGrid[h][w]);
+    for (int h=0; h < myBoard->height; h++) {
+        for (int w =0; w < myBoard->width; w++) {
+            printf("%c ", boardGet(myBoard, w, h));
         }
         printf("\n");
     }
     printf("\n");
 }
 
-int main() {
-    
+#ifdef VALIDATE_REPLAY
+//debug: replay the finished game on bitboards and compare with the per move result
+void validateReplay(gd* gridData, int filledCount, int width, int height, int streak_size, char winner){
+    bitboard myBits;
+    bitboardInit(&myBits, width, height);
+
+    bool isChecked[256] = {false};
+    for (int m = 0; m < filledCount; m++) {
+        unsigned char playerChar = gridData[m].character;
+        if (isChecked[playerChar]) {
+            continue;
+        }
+        isChecked[playerChar] = true;
+
+        // every mark of this player
+        bitboardClear(&myBits);
+        for (int k = m; k < filledCount; k++) {
+            if (gridData[k].character == playerChar) {
+                bitboardSet(&myBits, gridData[k].position.x, gridData[k].position.y);
+            }
+        }
 
-    // initialize game state from input
+        bool hasStreak = bitboardHasStreak(&myBits, streak_size);
+        if (hasStreak != (playerChar == winner)) {
+            fprintf(stderr, "replay check: player %c %s a streak of %d\n", playerChar, hasStreak ? "has" : "does not have", streak_size);
+        }
+    }
+    bitboardFree(&myBits);
+}
+#endif
+
+typedef struct myGame myGame;
+
+typedef struct myPlayer {
+    char character;
+    int argCount;
+    char **arguments;   //argument array
+    int fd;             // server end of the bidirectional socket
+    int pid;
+    bool isDelta;       // asked for START_DELTA, RESULTs carry only new marks
+    int sentCount;      // gridData entries the player already has
+    sendQueue output;   // replies not written yet
+    uint32_t events;    // epoll events registered for the socket
+    bool isOpen;        // socket still watched, player has not closed its end
+    bool isStarted;     // sent START in this game, earlier messages are dropped
+    bool isReset;       // pooled process from an earlier game, got RESET for this one
+    int poolIndex;      // process in the player pool, -1 without a pool
+    char inbox[INBOX_SIZE];     // received bytes, complete messages are taken from the front
+    int inboxStart;
+    int inboxEnd;
+    myGame* game;       // game the player is in, epoll events only carry the player
+} myPlayer;
+
+// one game slot of the server
+// board, streaks, history and players are kept when the game ends,
+// the next game in the slot resets them instead of allocating again
+struct myGame {
+    int number;         // position in the input, results are announced with it
     int width, height, streak_size, player_count;
-	scanf("%d %d %d %d", &width, &height, &streak_size, &player_count);
+    board myBoard;
+    streakTable myStreaks;
+    gridHistory myHistory;
+    myPlayer* myPlayers;
+    int playerCapacity;     // players allocated in the slot
+    bool isAllocated;       // buffers exist, reset them for the next game
+    bool isRunning;
+    bool isGameOver;
+    char myWinner;
+    bool isDraw;
+    int activeCount;        // players whose socket is still open
+};
+
+// RESULT reply with grid data
+// full gridData normally, in delta mode only the entries the player has not seen.
+// the player reads each reply before sending again, so its next message acknowledges this one
+void sendResult(myPlayer* player, int success, gridHistory* history){
+    gd* gridData = history->entries;
+    int filledCount = history->count;
+    int first = player->isDelta ? player->sentCount : 0;
+
+    sm myServerMessage;
+    myServerMessage.type = RESULT;
+    myServerMessage.success = success;
+    myServerMessage.filled_count = filledCount;     // total, also in delta mode
+
+    // server message
+    smp myServerPrint;
+    myServerPrint.process_id = player->pid;
+    myServerPrint.server_message = &myServerMessage;
+
+    // print response, what is actually sent
+    print_output(NULL, &myServerPrint, (gu *)(gridData + first), filledCount - first);
+
+    // server response message, header and grid data leave together with the next flush
+    // grid data is not copied, history entries stay in place for the whole game
+    sendQueuePush(&player->output, &myServerMessage, sizeof(sm));
+    sendQueuePush(&player->output, gridData + first, (filledCount - first) * sizeof(gd));
+
+    player->sentCount = filledCount;
+}
 
-    //debug
-    //printf("width:%d, height: %d, streak_size: %d, player_count:%d\n", width, height, streak_size, player_count);
+// END message to all players, queued behind whatever they still have to get
+void broadcastEnd(myPlayer* myPlayers, int player_count){
+    sm myServerMessage;
+    myServerMessage.type = END;
+    myServerMessage.success = 1;    //mark successful
+    myServerMessage.filled_count = 0;   //change filled count zero to terminate child
+
+    for(int endIndex=0; endIndex < player_count; endIndex++){
+        sendQueuePush(&myPlayers[endIndex].output, &myServerMessage, sizeof(sm));
+
+        // printing message
+        smp myServerPrint;
+        myServerPrint.process_id = myPlayers[endIndex].pid;
+        myServerPrint.server_message = &myServerMessage;
+
+        // print END message
+        print_output(NULL, &myServerPrint, NULL, 0);
+    }
+}
+
+// write queued replies of a player, one sendmsg for all of them
+// if the socket is full the rest waits for EPOLLOUT.
+// backpressure: while the queue is full the player's requests are not read
+void flushPlayer(int epollFd, myPlayer* player){
+    sendQueueFlush(&player->output, player->fd);
+
+    if (!player->isOpen) {
+        // not in the epoll set anymore
+        return;
+    }
+
+    uint32_t events = EPOLLET;
+    if (!sendQueueFull(&player->output)) {
+        events |= EPOLLIN;
+    }
+    if (!sendQueueEmpty(&player->output)) {
+        events |= EPOLLOUT;
+    }
 
-    char** myGrid = malloc(height*sizeof(char*));
-    for (int h=0; h<height; h++) {
-        myGrid[h] = malloc(width);
-        for (int w = 0; w < width; w++) {
-            myGrid[h][w] = '.';
+    if (events != player->events) {
+        struct epoll_event myEvent;
+        myEvent.events = events;
+        myEvent.data.ptr = player;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, player->fd, &myEvent);
+        player->events = events;
+    }
+}
+
+// next client message of a player, socket is non-blocking
+// one read can bring several messages or part of one, they wait in the inbox
+// returns sizeof(cm), 0 when the player is gone, -1 when no complete message is there yet
+int nextMessage(myPlayer* player, cm* myClientMessage){
+    while (player->inboxEnd - player->inboxStart < (int)sizeof(cm)) {
+        // move the partial message to the front, room for the next read
+        if (player->inboxStart > 0) {
+            memmove(player->inbox, player->inbox + player->inboxStart, player->inboxEnd - player->inboxStart);
+            player->inboxEnd -= player->inboxStart;
+            player->inboxStart = 0;
+        }
+
+        int n = read(player->fd, player->inbox + player->inboxEnd, INBOX_SIZE - player->inboxEnd);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? -1 : 0;
         }
+        if (n == 0) {
+            return 0;
+        }
+        player->inboxEnd += n;
     }
 
+    memcpy(myClientMessage, player->inbox + player->inboxStart, sizeof(cm));
+    player->inboxStart += sizeof(cm);
+    return sizeof(cm);
+}
+
+// read one game configuration into a slot
+// width height streak_size player_count, then per player: character argCount path arguments
+// returns false at the end of the input
+bool readGame(FILE* input, myGame* game){
+    int width, height, streak_size, player_count;
+    if (fscanf(input, "%d %d %d %d", &width, &height, &streak_size, &player_count) != 4) {
+        return false;
+    }
 
     //debug
-    //printGrid(myGrid, height, width);
-
-    typedef struct myPlayer {
-        char character;
-        int argCount;
-        char **arguments;   //argument array
-        int fd[2]; // socket, bidirectional pipe use
-        int pid;
-    } myPlayer;
-
-    // creating array of players
-    myPlayer* myPlayers = malloc(player_count*sizeof(myPlayer));
+    //printf("width:%d, height: %d, streak_size: %d, player_count:%d\n", width, height, streak_size, player_count);
+
+    game->width = width;
+    game->height = height;
+    game->streak_size = streak_size;
+    game->player_count = player_count;
+
+    if (!game->isAllocated) {
+        // one contiguous board with border cells around it
+        boardInit(&game->myBoard, width, height);
+
+        // run lengths for win checks, one update per mark
+        streakInit(&game->myStreaks, &game->myBoard);
+
+        // grid data to send current game state
+        // reserved for the whole board, marks never reallocate it
+        gridHistoryInit(&game->myHistory, width*height);    //there is no marked position
+
+        game->isAllocated = true;
+    }
+    else {
+        // previous game of the slot is over, its memory is reused
+        boardReset(&game->myBoard, width, height);
+        streakReset(&game->myStreaks, &game->myBoard);
+        gridHistoryReset(&game->myHistory, width*height);
+    }
+
+    // players array only grows, the slot is not in epoll while it moves
+    if (player_count > game->playerCapacity) {
+        game->myPlayers = realloc(game->myPlayers, player_count*sizeof(myPlayer));
+        for (int i = game->playerCapacity; i < player_count; i++) {
+            sendQueueInit(&game->myPlayers[i].output, OUTPUT_LIMIT);
+        }
+        game->playerCapacity = player_count;
+    }
+
+    myPlayer* myPlayers = game->myPlayers;
     for (int i=0; i < player_count; i++) {
-        scanf(" %c %d", &myPlayers[i].character, &myPlayers[i].argCount);
+        fscanf(input, " %c %d", &myPlayers[i].character, &myPlayers[i].argCount);
 
         //dynamic allocation
         // zero index is executable path
@@ -125,16 +332,24 @@ int main() {
         
         // executable path input, size 200 should be more?
         myPlayers[i].arguments[0] = malloc(200);
-        scanf("%s", myPlayers[i].arguments[0]);
+        fscanf(input, "%s", myPlayers[i].arguments[0]);
         
         // taking arguments input
         for (int j=0; j < myPlayers[i].argCount; j++) {
             myPlayers[i].arguments[j+1] = malloc(200);
-            scanf("%s", myPlayers[i].arguments[j+1]);
+            fscanf(input, "%s", myPlayers[i].arguments[j+1]);
         }
         
         // last is null
         myPlayers[i].arguments[myPlayers[i].argCount+1] = NULL;
+
+        // full grid data until the player asks for deltas
+        myPlayers[i].isDelta = false;
+        myPlayers[i].sentCount = 0;
+        sendQueueReset(&myPlayers[i].output);
+        myPlayers[i].inboxStart = 0;
+        myPlayers[i].inboxEnd = 0;
+        myPlayers[i].game = game;
     }
 
     //debug
@@ -147,493 +362,332 @@ int main() {
     }*/
     //
 
-    
+    game->isGameOver = false;
+    game->myWinner = '.';
+    game->isDraw = false;
+    return true;
+}
+
+// create the player processes of a game and watch their sockets
+// with a pool the processes of earlier games are reused
+void startGame(myGame* game, int epollFd, playerPool* pool){
+    myPlayer* myPlayers = game->myPlayers;
+
     // Set up communication channels with players
-    
-    // create bidirectional pipes from main proccess to each player
-    // in biredirectional pipes, both ends can read and write
-    int pids[player_count];
+    // one bidirectional socket per player, then fork and exec it
+    for (int i=0; i<game->player_count; i++) {
+        if (pool != NULL) {
+            int index = playerPoolAcquire(pool, myPlayers[i].arguments);
+            myPlayers[i].poolIndex = index;
+            myPlayers[i].fd = index >= 0 ? pool->players[index].fd : -1;
+            myPlayers[i].pid = index >= 0 ? pool->players[index].pid : -1;
+            if (index < 0) {
+                continue;
+            }
 
-    for (int i=0; i<player_count; i++) {  
-        PIPE(myPlayers[i].fd);
+            // a reused process may still send marks of its previous game
+            // a message cut by the previous game continues in this inbox
+            myPlayers[i].isStarted = false;
+            myPlayers[i].isReset = true;
+            memcpy(myPlayers[i].inbox, pool->players[index].partial, pool->players[index].partialLength);
+            myPlayers[i].inboxEnd = pool->players[index].partialLength;
+        }
+        else {
+            myPlayers[i].poolIndex = -1;
+            myPlayers[i].pid = spawnPlayer(myPlayers[i].arguments, &myPlayers[i].fd);
+            myPlayers[i].isStarted = true;
+            myPlayers[i].isReset = false;
+        }
         //debug
-        //printf("Created bidirectional pipe for player %d: fd[0]=%d, fd[1]=%d\n", i + 1, myPlayers[i].fd[0], myPlayers[i].fd[1]);
+        //printf("Created player %c process with PID: %d\n", myPlayers[i].character, myPlayers[i].pid);
     }
 
-    
-    //fork player processes and set up communication
-    for (int i=0; i<player_count; i++) {
-        pids[i] = fork();
+    // registered once, only ready players come back from epoll_wait
+    // a player that could not be started is in the game as one that left
+    game->activeCount = 0;
+    for (int i=0; i<game->player_count; i++) {
+        if (myPlayers[i].pid < 0) {
+            myPlayers[i].isOpen = false;
+            continue;
+        }
 
-        if (pids[i]>0){  //parent
-            //printf("Created player %c process with PID: %d\n", myPlayers[i].character, pids[i]);
-            
-            // Store the player's PID
-            myPlayers[i].pid = pids[i];
-            
-            // Close the child end of the pipe
-            close(myPlayers[i].fd[1]);
-            
-            // Keep fd[0] open for communication with this player
+        struct epoll_event myEvent;
+        myEvent.events = EPOLLIN | EPOLLET;     // edge triggered, drain on every wakeup
+        myEvent.data.ptr = &myPlayers[i];
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, myPlayers[i].fd, &myEvent);
+        myPlayers[i].events = myEvent.events;
+        myPlayers[i].isOpen = true;
+        game->activeCount++;
+    }
+    game->isRunning = true;
+}
+
+// update the game for one client message and queue the replies
+void handleMessage(myGame* game, myPlayer* player, cm* myClientMessage){
+    //START: Sent when a player process is initialized. The server responds by sending the current state of the board.
+    //START_DELTA: same, later RESULTs only carry marks the player has not seen
+    //RESYNC: player lost track, send the whole board again
+    if(myClientMessage->type == START || myClientMessage->type == START_DELTA || myClientMessage->type == RESYNC){
+        
+        if (myClientMessage->type != RESYNC) {
+            player->isDelta = (myClientMessage->type == START_DELTA);
         }
 
-        else {
-            //child process- player
-            //printf("child process player %c started (PID: %d)\n", myPlayers[i].character, getpid());
-            
-            dup2(myPlayers[i].fd[1], 0);    // dup stdin to pipe write end
-            dup2(myPlayers[i].fd[1], 1);    // dup stdout to pipe write end
-            
-            close(myPlayers[i].fd[0]);      // close read end (server)
-            close(myPlayers[i].fd[1]);      // close dup2()ed end 
-            
+        // since there is no success marking, i dont add anything to gridData
+        // full snapshot in every mode
+        player->sentCount = 0;
+        sendResult(player, 0, &game->myHistory);    //there is no mark success
+        
+        //debug
+        // - printGrid(&game->myBoard);
+    }
+
+
+    else if(myClientMessage->type == MARK){   
+        // checking mark position
+        int positionX = myClientMessage->position.x;
+        int positionY = myClientMessage->position.y;
+        // for a poisition to be marked it should be inside the grid
+        //  position should be empty = dots
+        // boardMark checks the bounds before touching the cell
+        if (boardMark(&game->myBoard, positionX, positionY, player->character)) {
+
+            // mark position was empty, board is updated
+
+            // longest run through the new mark
+            int markStreak = streakMark(&game->myStreaks, positionX, positionY);
+
+            // adding character to grid data with the marked position
+            // space was reserved for every cell, no allocation here
+            gridHistoryAppend(&game->myHistory, positionX, positionY, player->character);
             
-            if (execv(myPlayers[i].arguments[0], myPlayers[i].arguments)) {
-				perror("execv");
-				return -1;
-			}
+
+            //check draw
+            if(game->myHistory.count == (game->width*game->height)){
+                //debug
+                //printf("Draw\n");
+                game->isGameOver = true;
+                game->isDraw = true;
+                
+                // first send RESULT message then END
+                sendResult(player, 1, &game->myHistory);    //marked
+                
+                //debug
+                //printGrid(&game->myBoard);
+
+
+                // sending END message to all players
+                broadcastEnd(game->myPlayers, game->player_count);
+            }
+
+            else{
+                // checking if a player won the game
+                // runs through the mark were merged by streakMark
+                if(markStreak >= game->streak_size){
+                    // case for mark succesfull, no draw, yes win
+                    game->myWinner = player->character;
+                    game->isGameOver = true;
+
+                    // first send RESULT message then END
+                    sendResult(player, 1, &game->myHistory);    //marked
+                    
+                    //debug
+                    // - printGrid(&game->myBoard);
+
+                    
+                    // END message to all players
+                    broadcastEnd(game->myPlayers, game->player_count);
+                }
+
+                //no winner, game continues
+                else{
+                    // case for mark succesfull, no draw, no win
+                    sendResult(player, 1, &game->myHistory);    //mark successful
+                }
+            }          
+        } else {
+            //mark place is full already, or outside the grid
+            sendResult(player, 0, &game->myHistory);    //mark not successful
         }
     }
+}
 
-    
-    // while game is not over do
-        //Wait for player messages using select or poll
-        //Process each incoming message
-        //Update game state if the message is a valid mark
-        //Check if the game is won or if the grid is full
-        //Send appropriate responses to players
-    //end while
+// pooled process had exited at the END of its previous game, the RESET went nowhere
+// a new process takes its place, its first message is START
+// false if the new one could not be started
+bool restartPlayer(int epollFd, myPlayer* player, playerPool* pool){
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, player->fd, NULL);
+    if (!playerPoolRestart(pool, player->poolIndex)) {
+        player->fd = -1;
+        player->pid = -1;
+        return false;
+    }
+    player->fd = pool->players[player->poolIndex].fd;
+    player->pid = pool->players[player->poolIndex].pid;
+
+    // nothing of the old process is left to drop
+    // a new one that closes before START is gone for good, not started again
+    player->isReset = false;
+    player->inboxStart = 0;
+    player->inboxEnd = 0;
+    sendQueueReset(&player->output);
+
+    struct epoll_event myEvent;
+    myEvent.events = EPOLLIN | EPOLLET;
+    myEvent.data.ptr = player;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, player->fd, &myEvent);
+    player->events = myEvent.events;
+    return true;
+}
 
-    bool isGameOver = false;
-    int filledCount = 0;
-    char myWinner = '.';
-    bool isDraw = false;
+// epoll reported the socket of a player
+void playerEvent(int epollFd, myPlayer* player, uint32_t events, playerPool* pool){
+    myGame* game = player->game;
 
-    // grid data to send current game state
-    // sending filled posititon and caracter data
-    //from game_structs.h
-    //different for print_output
-    gd *gridData = NULL;    //creating emty grid data. there is no marked position
+    // socket has room again for queued replies
+    if (events & EPOLLOUT) {
+        flushPlayer(epollFd, player);
+    }
 
-    while(!isGameOver) {
-        fd_set readfds;     // set of file descriptors to read
-        int maxfd = 0;     // maximum numbered file descriptor
-        
-        /* setup for select() call. construct the set of file desriptors */
-        FD_ZERO(&readfds);
-        
-        for (int i=0; i<player_count; i++) {
-            FD_SET(myPlayers[i].fd[0], &readfds);
-            if (myPlayers[i].fd[0] > maxfd) {
-                maxfd = myPlayers[i].fd[0];
+    // edge triggered: read until nothing is left
+    // or until the player has too many replies it has not read
+    // once the game is over only the queued replies and END go out
+    while (!game->isGameOver && player->isOpen) {
+        if (sendQueueFull(&player->output)) {
+            flushPlayer(epollFd, player);
+            if (sendQueueFull(&player->output)) {
+                // EPOLLOUT brings us back here, inbox is kept
+                break;
             }
         }
 
-        struct timeval tv = {0, 1000}; // 1ms timeout
+        cm myClientMessage;
+        int n = nextMessage(player, &myClientMessage);
 
-        /* our file descriptors block only for reading
-           only define read set, set others to NULL */
-		//select(maxfd+1, &readfds, NULL, NULL, NULL); 
-        /* now, pset contains the descriptors that are ready.
-		   collect and consume all ready file descriptors 
-           more than one can be ready. so keep looping for all */
+        if (n < 0) {
+            // drained
+            break;
+        }
+        else if (n == 0) {
+            // closed before answering RESET
+            if (player->isReset && !player->isStarted && restartPlayer(epollFd, player, pool)) {
+                break;
+            }
 
-        // Wait for input on any player pipe
-        int ready = select(maxfd + 1, &readfds, NULL, NULL, &tv);
+            // player closed its end, nothing it was sent will be read
+            if (player->fd >= 0) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, player->fd, NULL);
+            }
+            sendQueueReset(&player->output);
+            player->isOpen = false;
+            game->activeCount--;
+            break;
+        }
+
+        // a pooled process starts over with START after RESET
+        // whatever it sent before belongs to its previous game
+        if (!player->isStarted) {
+            if (myClientMessage.type != START && myClientMessage.type != START_DELTA) {
+                continue;
+            }
+            player->isStarted = true;
+        }
+
+        //message taken, print client message
+        cmp myClientPrint;
+        myClientPrint.process_id = player->pid;
+        myClientPrint.client_message = &myClientMessage;
+        print_output(&myClientPrint, NULL, NULL, 0);
         
-        if (ready > 0) {
-            for (int i=   0; i <player_count; i++) {
-                // Check if this player's pipe has data to read
-                if (FD_ISSET(myPlayers[i].fd[0], &readfds)) { // this fd is ready to read
-                    /* BLOCKING READ. BUT WE KNOW THAT THERE IS DATA */
+        //debug
+        //printf("received message from player %c with pid: %d)\n", player->character, player->pid);
 
-                    // Read from pipe
+        handleMessage(game, player, &myClientMessage);
+    }
 
-                    int n;
-                    cm myClientMessage;
-                    n = read(myPlayers[i].fd[0], &myClientMessage, sizeof(cm));
-                    
-                    if (n <= 0) {
-                        /*
-                        active[i] = 0;
-					    activecount--;
-                        */
-                    } else {
-
-                        //message taken, print client message
-                        cmp myClientPrint;
-                        myClientPrint.process_id = myPlayers[i].pid;
-                        myClientPrint.client_message = &myClientMessage;
-                        print_output(&myClientPrint, NULL, NULL, 0);
-                        
-                        //debug
-                        //printf("received message from player %c with pid: %d)\n", myPlayers[i].character, myPlayers[i].pid);
-                        
-                        //START: Sent when a player process is initialized. The server responds by sending the current state of the board.
-                        if(myClientMessage.type == START){
-                            
-                            // server response
-                            sm myServerMessage;
-                            myServerMessage.type = RESULT;
-                            myServerMessage.success = 0;            //there is no mark success
-                            myServerMessage.filled_count = filledCount;
-
-                            // since there is no success marking, i dont add anything to gridData
-
-                            // server message
-                            smp myServerPrint;
-                            myServerPrint.process_id = myPlayers[i].pid;
-                            myServerPrint.server_message = &myServerMessage;
-                            
-                            // print response
-                            print_output(NULL, &myServerPrint, (gu *)gridData, filledCount);
-                            
-                            // server response message
-                            write(myPlayers[i].fd[0], &myServerMessage, sizeof(sm));
-                            write(myPlayers[i].fd[0], gridData, filledCount * sizeof(gd));
-                            
-                            //debug
-                            // - printGrid(myGrid, height, width);
-                        }
-
-
-                        else if(myClientMessage.type == MARK){   
-                            // checking mark position
-                            int positionX = myClientMessage.position.x;
-                            int positionY = myClientMessage.position.y;
-                            // for a poisition to be marked it should be inside the grid
-                            //  position should be empty = dots
-                            if (myGrid[positionY][positionX] == '.' &&
-                                positionX >= 0 && positionX < width &&
-                                positionY >= 0 && positionY < height ) {
-
-                                // mark position is empty
-                                
-                                // update myGrid with char
-                                myGrid[positionY][positionX] = myPlayers[i].character;
-                                filledCount++;
-
-                                // adding character to grid data with the marked position
-                                // so, i resize the gridData with filled countt
-                                gd *newGridData = realloc(gridData, (filledCount)*sizeof(gd));
-                                
-                                gridData = newGridData;
-
-                                //filling the grid data with the marked position
-                                gridData[filledCount-1].position.x = positionX;
-                                gridData[filledCount-1].position.y = positionY;
-                                gridData[filledCount-1].character = myPlayers[i].character;
-                                
-
-                                //check draw
-                                if(filledCount == (width*height)){
-                                    //debug
-                                    //printf("Draw\n");
-                                    isGameOver = true;
-                                    isDraw = true;
-                                    
-                                    // first send RESULT message then END
-                                    sm myServerMessage;
-                                    myServerMessage.type = RESULT;
-                                    myServerMessage.success = 1;            //marked
-                                    myServerMessage.filled_count = filledCount;
-
-                                    // server message
-                                    smp myServerPrint;
-                                    myServerPrint.process_id = myPlayers[i].pid;
-                                    myServerPrint.server_message = &myServerMessage;
-                                    
-                                    // print response
-                                    print_output(NULL, &myServerPrint, (gu*)gridData, filledCount);
-                                    
-                                    // server response message
-                                    write(myPlayers[i].fd[0], &myServerMessage, sizeof(sm));
-                                    write(myPlayers[i].fd[0], gridData, filledCount * sizeof(gd));
-                                    
-                                    //debug
-                                    //printGrid(myGrid, height, width);
-
-
-                                    // sending END message to all players
-                                    for(int endIndex=0; endIndex < player_count; endIndex++){
-                                        
-                                        sm myServerMessage;
-                                        myServerMessage.type = END;
-                                        myServerMessage.success = 1;    //mark successful
-                                        myServerMessage.filled_count = 0;   //change filled count zero to terminate child
-
-                                        // printing message
-                                        smp myServerPrint;
-                                        myServerPrint.process_id = myPlayers[endIndex].pid;
-                                        myServerPrint.server_message = &myServerMessage;
-
-                                        write(myPlayers[endIndex].fd[0], &myServerMessage, sizeof(sm));
-                                        
-                                        // print END message
-                                        print_output(NULL, &myServerPrint, NULL, 0);
-                                    }
-                                    break;  //game over
-                                    
-                                }
-
-                                else{
-                                    // checking if a player won the game
-                                    //checking using the last marked character and position
-                                    int positionX = myClientMessage.position.x;
-                                    int positionY = myClientMessage.position.y;
-                                    char playerChar = myPlayers[i].character;   
-
-                                    int currentStreak=1;    //i already marked one position
-                                    
-                                    //checking row win
-                                    //position Y doesnt change
-                                    //checking the left of the marked position
-                                    for(int i = positionX-1; i >= 0; i--){
-                                        if(myGrid[positionY][i] == playerChar){
-                                            currentStreak++;
-                                        }
-                                        //there is no more streak to that side
-                                        else{
-                                            break;
-                                        }
-                                    }
-
-                                    //checking the right of the marked position
-                                    for(int i = positionX+1; i < width; i++){
-                                        if(myGrid[positionY][i] == playerChar){
-                                            currentStreak++;
-                                        }
-                                        else{
-                                            break;
-                                        }
-                                    }
-                                    if(currentStreak >= streak_size){
-                                        myWinner = playerChar;
-                                        isGameOver = true;
-                                        //printf("row win\n");
-                                    }
-
-                                    //if there is no winner, check column
-                                    if(myWinner == '.'){
-                                        currentStreak = 1;
-                                        //check above side of the position
-                                        for(int i=positionY-1; i >= 0; i--){
-                                            if(myGrid[i][positionX] == playerChar){
-                                                currentStreak++;
-                                            }
-                                            else{
-                                                break;
-                                            }
-                                        }
-                                        //check below side of the position
-                                        for(int i= positionY+1; i < height; i++){
-                                            if(myGrid[i][positionX] == playerChar){
-                                                currentStreak++;
-                                            }
-                                            else{
-                                                break;
-                                            }
-                                        }
-                                        if(currentStreak >= streak_size){
-                                            myWinner = playerChar;
-                                            isGameOver = true;
-                                            //printf("column win\n");
-                                        }
-                                    }
-
-                                    //if there is no winner, check diagonal lef up to right down
-                                    if(myWinner == '.'){
-                                        currentStreak = 1;
-                                        //check left up side of the position
-                                        int k = positionX-1;
-                                        int l = positionY-1;
-                                        while(k >= 0 && l >= 0){
-                                            if(myGrid[l][k] == playerChar){
-                                                currentStreak++;
-                                            }
-                                            else{
-                                                break;
-                                            }
-                                            k--;
-                                            l--;
-                                        }
-                                        //check right down side of the position
-                                        k = positionX+1;
-                                        l = positionY+1;
-                                        while(k < width && l < height){
-                                            if(myGrid[l][k] == playerChar){
-                                                currentStreak++;
-                                            }
-                                            else{
-                                                break;
-                                            }
-                                            k++;
-                                            l++;
-                                        }
-                                        if(currentStreak >= streak_size){
-                                            myWinner = playerChar;
-                                            isGameOver = true;
-                                            //printf("left top to bottom win\n");
-                                        }
-                                    }
-
-                                    //if there is no winner, check diagonal left down to right up
-                                    if(myWinner == '.'){
-                                        currentStreak = 1;
-                                        //check left down side of the position
-                                        int k = positionX-1;
-                                        int l = positionY+1;
-                                        while(k >= 0 && l < height){
-                                            if(myGrid[l][k] == playerChar){
-                                                currentStreak++;
-                                            }
-                                            else{
-                                                break;
-                                            }
-                                            k--;
-                                            l++;
-                                        }
-                                        //check right up side of the position
-                                        k = positionX+1;
-                                        l = positionY-1;
-                                        while(k < width && l >= 0){
-                                            if(myGrid[l][k] == playerChar){
-                                                currentStreak++;
-                                            }
-                                            else{
-                                                break;
-                                            }
-                                            k++;
-                                            l--;
-                                        }
-                                        if(currentStreak >= streak_size){
-                                            myWinner = playerChar;
-                                            isGameOver = true;
-                                            //printf("left bottom to right top win\n");
-                                        }
-                                    }
-
-
-                                    //if there is a winner, send RESULT and END message
-                                    if(myWinner != '.'){
-                                        // case for mark succesfull, no draw, yes win
-                                        isGameOver = true;
-
-                                        // first send RESULT message then END
-                                        sm myServerMessage;
-                                        myServerMessage.type = RESULT;
-                                        myServerMessage.success = 1;            //marked
-                                        myServerMessage.filled_count = filledCount;
-
-                                        // server message
-                                        smp myServerPrint;
-                                        myServerPrint.process_id = myPlayers[i].pid;
-                                        myServerPrint.server_message = &myServerMessage;
-                                        
-                                        // print response
-                                        print_output(NULL, &myServerPrint, (gu *)gridData, filledCount);
-                                        
-                                        // server response message
-                                        write(myPlayers[i].fd[0], &myServerMessage, sizeof(sm));
-                                        write(myPlayers[i].fd[0], gridData, filledCount * sizeof(gd));
-                                        
-                                        //debug
-                                        // - printGrid(myGrid, height, width);
-
-                                        
-                                        // END message to all players
-                                        for(int endIndex = 0; endIndex < player_count; endIndex++){
-                                        
-                                            sm myServerMessage;
-                                            myServerMessage.type = END;
-                                            myServerMessage.success = 1;    //mark successful
-                                            myServerMessage.filled_count = 0; // change filled count zero to terminate child
-
-                                            // printing message
-                                            smp myServerPrint;
-                                            myServerPrint.process_id = myPlayers[endIndex].pid;
-                                            myServerPrint.server_message = &myServerMessage;
-
-                                            write(myPlayers[endIndex].fd[0], &myServerMessage, sizeof(sm));
-                                            
-                                            // print END message
-                                            print_output(NULL, &myServerPrint, NULL, 0);
-                                        }
-                                        break;  //game over
-                                    }
-
-                                    //no winner, game continues
-                                    else{
-                                        // case for mark succesfull, no draw, no win
-                                        sm myServerMessage;
-                                        myServerMessage.type = RESULT;
-                                        myServerMessage.success = 1;            //mark successful
-                                        myServerMessage.filled_count = filledCount;
-
-                                        // server msgsage
-                                        smp myServerPrint;
-                                        myServerPrint.process_id = myPlayers[i].pid;
-                                        myServerPrint.server_message = &myServerMessage;
-                                        
-                                        // print response
-                                        print_output(NULL, &myServerPrint, (gu *)gridData, filledCount);
-                                        
-                                        //sending response and gridData 
-                                        write(myPlayers[i].fd[0], &myServerMessage, sizeof(sm));
-                                        write(myPlayers[i].fd[0], gridData, filledCount * sizeof(gd));
-                                    }
-                                }          
-                            } else {
-                                //mark place is full already
-                                sm myServerMessage;
-                                myServerMessage.type = RESULT;
-                                myServerMessage.success = 0;      //mark not successful
-                                myServerMessage.filled_count = filledCount;
-
-                                // server print
-                                smp myServerPrint;
-                                myServerPrint.process_id = myPlayers[i].pid;
-                                myServerPrint.server_message = &myServerMessage;
-                                
-                                // print response
-                                print_output(NULL, &myServerPrint, (gu *)gridData, filledCount);
-                                
-                                //sending response and gridData 
-                                write(myPlayers[i].fd[0], &myServerMessage, sizeof(sm));
-                                write(myPlayers[i].fd[0], gridData, filledCount * sizeof(gd));
-                            }
-                        }
-                    }
-                }
-            }
+    if (game->isGameOver) {
+        // END was queued for everyone, not only for this player
+        for (int i = 0; i < game->player_count; i++) {
+            flushPlayer(epollFd, &game->myPlayers[i]);
         }
     }
+    else {
+        // replies to everything read from this player go out in one write
+        flushPlayer(epollFd, player);
+    }
+}
 
+// game is over and every player got its END, or no player is left
+bool isGameFinished(myGame* game){
+    if (!game->isGameOver && game->activeCount > 0) {
+        return false;
+    }
+    for (int i = 0; i < game->player_count; i++) {
+        if (!sendQueueEmpty(&game->myPlayers[i].output)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// announce the result, close the sockets and reap the players
+// the slot keeps its buffers for the next game
+void finishGame(myGame* game, int epollFd, playerPool* pool, bool isNumbered){
+    myPlayer* myPlayers = game->myPlayers;
 
     //debug
-    //printGrid(myGrid, height, width);
+    //printGrid(&game->myBoard);
+
+#ifdef VALIDATE_REPLAY
+    validateReplay(game->myHistory.entries, game->myHistory.count, game->width, game->height, game->streak_size, game->myWinner);
+#endif
+
+#ifdef ALLOC_STATS
+    //debug: grid history should allocate once per slot, not per game
+    fprintf(stderr, "grid history: %d allocations, %ld bytes, %d marks\n", game->myHistory.allocations, game->myHistory.allocatedBytes, game->myHistory.count);
+#endif
+
+    // with many games every result says which game it belongs to
+    if (isNumbered) {
+        printf("Game %d: ", game->number);
+    }
 
     // Announce the winner or declare a draw
-    if(isDraw){
+    if(game->isDraw){
         printf("Draw\n");
     }
 
-    if(myWinner != '.'){
-        printf("Winner: Player%c\n", myWinner); // For a win
+    if(game->myWinner != '.'){
+        printf("Winner: Player%c\n", game->myWinner); // For a win
+    }
+    else if (isNumbered && !game->isDraw) {
+        // every player left before the game ended
+        printf("No result\n");
     }
 
 
 
-    // Clean up resources and terminate
+    // Clean up resources of the game
 
-    //free myGrid - 2d dimensions
-    for (int i = 0; i < height; i++) {
-        free(myGrid[i]);
-    }
-    free(myGrid);
+    for (int i = 0; i < game->player_count; i++) {
+        if (myPlayers[i].isOpen) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, myPlayers[i].fd, NULL);
+        }
+
+        if (myPlayers[i].poolIndex >= 0) {
+            // process stays for the next game, unless it closed its socket
+            // or its START was never read: it may exit on END with that START still unread,
+            // and the next game would take the stale START for an answer to RESET
+            // unread messages belong to this game, only a cut one is kept to find the next START
+            playerPoolRelease(pool, myPlayers[i].poolIndex, myPlayers[i].isOpen && myPlayers[i].isStarted,
+                              myPlayers[i].inbox + myPlayers[i].inboxStart, myPlayers[i].inboxEnd - myPlayers[i].inboxStart);
+        }
+        else if (myPlayers[i].fd >= 0) {
+            //closing pipes
+            close(myPlayers[i].fd);
+        }
 
-    // free arguments of players
-    for (int i = 0; i < player_count; i++) {
+        // free arguments of players
         free(myPlayers[i].arguments[0]);
         for (int j = 1; j < myPlayers[i].argCount + 1; j++) {
             free(myPlayers[i].arguments[j]);
@@ -643,33 +697,169 @@ int main() {
         //debug
         //printf("free memory of player %d\n", i + 1);
     }
+    
+    // The server must reap all child processes to avoid zombie processes.
+    // pooled ones are reaped by the pool
 
-    //closing pipes
-    for (int i = 0; i < player_count; i++) {
-        close(myPlayers[i].fd[0]);
-        close(myPlayers[i].fd[1]);
+    for (int i = 0; i < game->player_count; i++) {
+        if (myPlayers[i].poolIndex < 0 && myPlayers[i].pid > 0) {
+            //waiting child to terminate
+            int status;
+            waitpid(myPlayers[i].pid, &status, 0);
+        }
+    }
 
-        //debug
-        //printf("closed pipe to player %d\n", i + 1);
+    game->isRunning = false;
+}
+
+// free the buffers of a slot, after its last game
+void freeGame(myGame* game){
+    if (game->isAllocated) {
+        //free board
+        boardFree(&game->myBoard);
+        streakFree(&game->myStreaks);
+        gridHistoryFree(&game->myHistory);
     }
 
-    free(myPlayers);
-    //printf("free memory for players\n");
+    for (int i = 0; i < game->playerCapacity; i++) {
+        sendQueueFree(&game->myPlayers[i].output);
+    }
+    free(game->myPlayers);
+}
+
+// server [-g games_file] [-j concurrent_games] [-p]
+// without options one game is read from stdin, as before.
+// -g reads game configurations until the end of the file ("-" is stdin)
+// and runs up to -j of them at the same time in this process.
+// -p keeps player processes for later games, players must handle RESET
+int main(int argc, char* argv[]) {
+    FILE* input = stdin;
+    bool isMultiGame = false;
+    int slotCount = 0;
+    bool isPooled = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "g:j:p")) != -1) {
+        if (option == 'g') {
+            isMultiGame = true;
+            if (strcmp(optarg, "-") != 0) {
+                input = fopen(optarg, "r");
+                if (input == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+            }
+        }
+        else if (option == 'j') {
+            slotCount = atoi(optarg);
+        }
+        else if (option == 'p') {
+            isPooled = true;
+        }
+        else {
+            fprintf(stderr, "usage: %s [-g games_file] [-j concurrent_games] [-p]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!isMultiGame) {
+        slotCount = 1;
+    }
+    else if (slotCount < 1) {
+        slotCount = DEFAULT_SLOTS;
+    }
 
-    free(gridData);
-    //printf("free memory for gridData\n");
-    
     
-    // The server must reap all child processes to avoid zombie processes.
+    // while games are left do
+        //Start games in free slots
+        //Wait for player messages of every running game
+        //Process each incoming message
+        //Update game state if the message is a valid mark
+        //Check if the game is won or if the grid is full
+        //Send appropriate responses to players
+        //Finish games whose players got END
+    //end while
 
-    for (int i = 0; i < player_count; i++) {
-        //waiting child to terminate
-        int status;
-        waitpid(pids[i], &status, 0);
+    myGame* myGames = calloc(slotCount, sizeof(myGame));
+
+    // processes started for one game wait here for the next one
+    playerPool myPool;
+    playerPool* pool = NULL;
+    if (isPooled) {
+        playerPoolInit(&myPool, POOL_LIMIT);
+        pool = &myPool;
     }
+    int gameCount = 0;
+    int runningCount = 0;
+    bool isInputLeft = true;
+
+    // one epoll instance watching the player sockets of every game
+    // close-on-exec, players do not inherit it
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    while (true) {
+        // free slots take the next configurations
+        for (int s = 0; s < slotCount && isInputLeft; s++) {
+            if (myGames[s].isRunning) {
+                continue;
+            }
+            if (!readGame(input, &myGames[s])) {
+                isInputLeft = false;
+                break;
+            }
+            myGames[s].number = ++gameCount;
+            startGame(&myGames[s], epollFd, pool);
+            runningCount++;
+
+            // single game mode reads exactly one configuration
+            if (!isMultiGame) {
+                isInputLeft = false;
+            }
+        }
+
+        if (runningCount == 0) {
+            break;
+        }
+
+        struct epoll_event myEvents[MAX_EVENTS];
+
+        // Wait for input on any player pipe, no timeout
+        int ready = epoll_wait(epollFd, myEvents, MAX_EVENTS, -1);
+
+        for (int e = 0; e < ready; e++) {
+            playerEvent(epollFd, myEvents[e].data.ptr, myEvents[e].events, pool);
+        }
+
+        // games end after the events, no event of this round points to a closed slot
+        for (int s = 0; s < slotCount; s++) {
+            if (myGames[s].isRunning && isGameFinished(&myGames[s])) {
+                finishGame(&myGames[s], epollFd, pool, isMultiGame);
+                runningCount--;
+            }
+        }
+    }
+
+    close(epollFd);
+
+    if (pool != NULL) {
+#ifdef ALLOC_STATS
+        //debug: with the same players in every game most should be reused
+        fprintf(stderr, "player pool: %d processes started, %d reused\n", pool->spawns, pool->resets);
+#endif
+        playerPoolFree(pool);
+    }
+
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    for (int s = 0; s < slotCount; s++) {
+        freeGame(&myGames[s]);
+    }
+    free(myGames);
     //printf("end of the program\n");
 
 
 
     return 0;
-}
\ No newline at end of file
+}
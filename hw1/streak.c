@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "streak.h"
+
+void streakInit(streakTable *table, const board *myBoard) {
+    for (int d = 0; d < STREAK_DIRECTIONS; d++) {
+        table->memory[d] = NULL;
+    }
+    table->cellCapacity = 0;
+    streakReset(table, myBoard);
+}
+
+void streakReset(streakTable *table, const board *myBoard) {
+    int stride = myBoard->stride;
+    size_t cellCount = (size_t)stride * (myBoard->height + 2);
+
+    table->myBoard = myBoard;
+    table->step[0] = 1;
+    table->step[1] = stride;
+    table->step[2] = stride + 1;
+    table->step[3] = 1 - stride;
+
+    for (int d = 0; d < STREAK_DIRECTIONS; d++) {
+        if (cellCount > table->cellCapacity) {
+            free(table->memory[d]);
+            table->memory[d] = malloc(cellCount * sizeof(int));
+        }
+        memset(table->memory[d], 0, cellCount * sizeof(int));
+        table->runs[d] = table->memory[d] + (myBoard->cells - myBoard->memory);
+    }
+    if (cellCount > table->cellCapacity) {
+        table->cellCapacity = cellCount;
+    }
+}
+
+void streakFree(streakTable *table) {
+    for (int d = 0; d < STREAK_DIRECTIONS; d++) {
+        free(table->memory[d]);
+        table->memory[d] = NULL;
+    }
+    table->cellCapacity = 0;
+}
+
+int streakMark(streakTable *table, int x, int y) {
+    const char *cells = table->myBoard->cells;
+    int index = boardIndex(table->myBoard, x, y);
+    char character = cells[index];
+    int longest = 0;
+
+    for (int d = 0; d < STREAK_DIRECTIONS; d++) {
+        int *runs = table->runs[d];
+        int step = table->step[d];
+
+        // cell was empty, so neighbor runs end right next to it
+        // border and other players' cells stop the run
+        int before = cells[index - step] == character ? runs[index - step] : 0;
+        int after = cells[index + step] == character ? runs[index + step] : 0;
+        int total = before + 1 + after;
+
+        // merged run length goes to its new ends and to the cell
+        runs[index] = total;
+        runs[index - before * step] = total;
+        runs[index + after * step] = total;
+
+        if (total > longest) {
+            longest = total;
+        }
+    }
+    return longest;
+}
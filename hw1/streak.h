@@ -0,0 +1,34 @@
+#ifndef STREAK_H
+#define STREAK_H
+
+#include "board.h"
+
+/*
+run length win detection
+every cell keeps the length of the run it belongs to in four directions.
+lengths are only exact at the two ends of a run, and that is enough:
+a new mark can only join runs that end right next to it.
+so one mark is O(1), does not depend on streak_size.
+run arrays share the board layout, border cells never match a player
+*/
+
+#define STREAK_DIRECTIONS 4     // row, column, left up to right down, left down to right up
+
+typedef struct streakTable {
+    const board *myBoard;
+    int *memory[STREAK_DIRECTIONS];     // same size as the board memory
+    int *runs[STREAK_DIRECTIONS];       // run length through each cell, exact at run ends
+    int step[STREAK_DIRECTIONS];        // index distance to the next cell
+    size_t cellCapacity;                // cells allocated per direction
+} streakTable;
+
+void streakInit(streakTable *table, const board *myBoard);
+void streakFree(streakTable *table);
+
+// no runs, for a reset board, memory is kept if it is large enough
+void streakReset(streakTable *table, const board *myBoard);
+
+// cell was just marked on the board, returns the longest run through it
+int streakMark(streakTable *table, int x, int y);
+
+#endif
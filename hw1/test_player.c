@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "game_structs.h"
+#include "game_protocol.h"
+
+/*
+player for pool_test.sh
+test_player width height seed log end|reset
+marks random cells, several at a time, so marks behind the winning one
+are still on their way when END comes.
+end:   exits on END like a player that knows nothing of RESET
+reset: stays after END, starts over with START on RESET, exits at end of file
+every game it gets to the END of appends its pid to log.
+a reply to nothing it sent in this game, e.g. to a mark of the previous
+game, makes it exit with status 2 without reaching END
+*/
+
+#define IN_FLIGHT 4     // requests sent and not answered yet
+
+static int readAll(void *data, size_t length) {
+    char *next = data;
+    while (length > 0) {
+        ssize_t got = read(0, next, length);
+        if (got <= 0) {
+            return -1;
+        }
+        next += got;
+        length -= got;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 6 || (strcmp(argv[5], "end") != 0 && strcmp(argv[5], "reset") != 0)) {
+        fprintf(stderr, "usage: %s width height seed log end|reset\n", argv[0]);
+        return 1;
+    }
+    int width = atoi(argv[1]);
+    int height = atoi(argv[2]);
+    srand(atoi(argv[3]));
+    int isResetting = strcmp(argv[5], "reset") == 0;
+
+    // marks sent after the winning one can hit a closed socket, END is still to be read
+    signal(SIGPIPE, SIG_IGN);
+
+    cm myClientMessage = {START, {0, 0}};
+    write(1, &myClientMessage, sizeof(cm));
+    int waiting = 1;
+
+    gd *grid = malloc(sizeof(gd) * (width * height + 1));
+    while (1) {
+        sm myServerMessage;
+        if (readAll(&myServerMessage, sizeof(sm)) < 0) {
+            return isResetting ? 0 : 1;
+        }
+
+        if (myServerMessage.type == END) {
+            int logFd = open(argv[4], O_WRONLY | O_APPEND | O_CREAT, 0644);
+            dprintf(logFd, "%d\n", getpid());
+            close(logFd);
+            if (!isResetting) {
+                return 0;
+            }
+
+            // next is RESET or end of file
+            if (readAll(&myServerMessage, sizeof(sm)) < 0) {
+                return 0;
+            }
+            if ((int)myServerMessage.type != RESET) {
+                fprintf(stderr, "test_player: message %d after END\n", myServerMessage.type);
+                return 2;
+            }
+
+            // replies to the marks behind the winning one never come
+            myClientMessage.type = START;
+            write(1, &myClientMessage, sizeof(cm));
+            waiting = 1;
+            continue;
+        }
+
+        if (waiting == 0) {
+            fprintf(stderr, "test_player: reply to nothing sent in this game\n");
+            return 2;
+        }
+        waiting--;
+        if (readAll(grid, myServerMessage.filled_count * sizeof(gd)) < 0) {
+            return 1;
+        }
+
+        while (waiting < IN_FLIGHT) {
+            myClientMessage.type = MARK;
+            myClientMessage.position.x = rand() % width;
+            myClientMessage.position.y = rand() % height;
+            write(1, &myClientMessage, sizeof(cm));
+            waiting++;
+        }
+    }
+}
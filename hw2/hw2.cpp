@@ -1,4 +1,9 @@
 #include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include <thread>
 #include "monitor.h"
 #include "hw2.h"
 
@@ -11,254 +16,510 @@
 
 // USAGE:
 
-class myMonitor : public Monitor {
+#define CACHE_LINE 64   // per item state is padded to this, items do not share lines
 
-   // inherit from Monitor
-
-   //supplier for aaa,bbb,ccc
-   Condition customerCV, supplierCV[3];     // condition varibles
-   
-   struct myStore {
-      int capAAA;
-      int capBBB;
-      int capCCC;
-      int maxOrder;
-      
-      int availAAA;
-      int availBBB;
-      int availCCC;
-   } store;
-
-
-   //global variables
-   bool maySupplyAAA;
-   bool maySupplyBBB;
-   bool maySupplyCCC;
-
-   int reservedAAA;  //reserved amount of AAA
-   int reservedBBB;
-   int reservedCCC;
-   
-   //The total number of items sold via buy() calls must equal the total number of items removed from avail.
-   int totalSold = 0;
-   int totalRemoved = 0;
+// a supplier whose n did not fit in the free capacity
+// a buy that frees capacity reserves it for the supplier and wakes only this one
+struct supplierWaiter {
+   bool isAdmitted;           // capacity was reserved for this supplier
+   Monitor::Condition admitted;
 
-   public:
-   //constructor
-   // pass "this" to cv constructors
-   myMonitor() : customerCV(this), supplierCV{Condition(this), Condition(this), Condition(this)} {
-      store.capAAA = 0;
-      store.capBBB = 0;
-      store.capCCC = 0;
-      store.maxOrder = 0;
-      
-      store.availAAA = 0;
-      store.availBBB = 0;
-      store.availCCC = 0;
-
-      maySupplyAAA = false;
-      maySupplyBBB = false;
-      maySupplyCCC = false;
-
-      reservedAAA = 0;
-      reservedBBB = 0;
-      reservedCCC = 0;
+   supplierWaiter(Monitor* owner) : admitted(owner) {
+      isAdmitted = false;
    }
+};
 
-   // will initialize the store with the given parameters.
-   void initStore(int cA, int cB, int cC, int mO) {
-      __synchronized__;
+// queue entry, n is copied next to the others so the queue is scanned
+// without touching the stacks of the waiting threads
+struct waitingSupply {
+   int n;
+   supplierWaiter* waiter;
+};
 
-      store.capAAA = cA;
-      store.capBBB = cB;
-      store.capCCC = cC;
-      store.maxOrder = mO;
 
-      // items available
-      store.availAAA = cA;
-      store.availBBB = cB;
-      store.availCCC = cC;
+// state of one item type with its own lock
+// suppliers of AAA do not wait for suppliers of BBB or CCC,
+// buyers only lock the items of their order
+class alignas(CACHE_LINE) itemMonitor : public Monitor {
 
-      //std::cout << "initStore done:" << cA << ", " << cB << ", " << cC <<std::endl;
-      //std::cout << "max order: " << mO << std::endl;
+   public:
+   std::vector<waitingSupply> suppliers;  // suppliers waiting for capacity, oldest first
+   int smallestWaiting;                   // smallest n in the queue, INT_MAX if empty
+
+   int cap;
+   int avail;
+   int reserved;     // capacity promised by maysupply, not supplied yet
+   int supplying;    // maysupply calls whose supply did not come yet
+
+   //The total number of items sold via buy() calls must equal the total number of items removed from avail.
+   int totalSold;
+   int totalRemoved;
+
+   itemMonitor() {
+      smallestWaiting = INT_MAX;
+      cap = 0;
+      avail = 0;
+      reserved = 0;
+      supplying = 0;
+      totalSold = 0;
+      totalRemoved = 0;
    }
 
-   // the call by the customer threads.
-   void buy(int aA, int aB, int aC) { 
-      __synchronized__;
+   int freeCapacity() {
+      return cap - avail - reserved;
+   }
 
-      int maxOrder = store.maxOrder;
-      //checking if order exceeds limit
-      if (aA > maxOrder || aB > maxOrder || aC > maxOrder) {
-         //std::cout << "order exceeds  limit" << std::endl;
+   // reserves capacity for n items, caller holds the item lock
+   void reserve(int n) {
+      //reserving n amount as a promise to supply
+      //from hw pdf:
+      //the capacity for n items is reserved for the supplier
+      //Other suppliers of the same item type may block if the remaining capacity is insufficient.
+      reserved += n;
+      supplying++;
+   }
+
+   // capacity grew, admits waiting suppliers first fit in arrival order
+   // as many as the free capacity takes, each woken one already has its reservation
+   // caller holds the item lock
+   void admitSuppliers() {
+      // most sales free less than any waiting supplier needs, nobody to wake
+      if (freeCapacity() < smallestWaiting) {
          return;
       }
 
-      //order is within limit
+      // whole queue is walked, the smallest n left is found on the way
+      // admitted ones are dropped, the others keep their order
+      smallestWaiting = INT_MAX;
+      size_t kept = 0;
+      for (size_t w = 0; w < suppliers.size(); w++) {
+         waitingSupply entry = suppliers[w];
+         if (entry.n > freeCapacity()) {
+            smallestWaiting = std::min(smallestWaiting, entry.n);
+            suppliers[kept++] = entry;
+            continue;
+         }
 
-      //checking if order exceeds available stock
-      //if so, wait for stock to be available
-      while (aA > store.availAAA || aB > store.availBBB || aC > store.availCCC) {
-         //std::cout << "order exceeds available stock" << std::endl;
-         //std::cout << "waiting stock" << std::endl;
-         customerCV.wait();
-         //std::cout << "stock done, processing order" << std::endl;
+         reserve(entry.n);
+         entry.waiter->isAdmitted = true;
+         entry.waiter->admitted.notify();
       }
+      suppliers.resize(kept);
+   }
+};
 
-      // order within limit and available stock
-      //processing order
-      
-      // removing items from available stock
-      store.availAAA -= aA;
-      store.availBBB -= aB;
-      store.availCCC -= aC;
-
-      // update total sold and removed
-      totalSold += aA + aB + aC;
-      totalRemoved += aA + aB + aC;
-
-      //std::cout << "order placed: " << aA << " AAA, " << aB << " BBB, " << aC << " CCC" << std::endl;
-      //std::cout << "total sold: " << totalSold << std::endl;
-      //std::cout << "total removed: " << totalRemoved << std::endl;
-
-      // if total sold items doesnt match the total removed
-      if(totalSold != totalRemoved) {
-         throw std::runtime_error("sold an removed item count different");
-      }
-      
-      //std::cout << "new stock: " << std::endl;
-      //std::cout << "AAA: " << store.availAAA << std::endl;
-      //std::cout << "BBB: " << store.availBBB << std::endl;
-      //std::cout << "CCC: " << store.availCCC << std::endl;
-
-      //notifying supplier threads stock might be available
-      for (int i = 0; i < 3; i++) {
-         supplierCV[i].notify();
+
+// cap and avail of one item for monitorStore(), read without the lock
+// kept apart from the item monitor, polling readers do not pull the writers' cache line
+// seq is odd while a writer changes them, a reader that saw it change reads again
+struct alignas(CACHE_LINE) itemSnapshot {
+   std::atomic<unsigned> seq;
+   std::atomic<int> cap;
+   std::atomic<int> avail;
+
+   itemSnapshot() {
+      seq = 0;
+      cap = 0;
+      avail = 0;
+   }
+
+   // writers hold the item lock and call beginUpdate() for every item they change
+   // before changing any of them, endUpdate() after. a change of several items
+   // is then never seen half done
+   void beginUpdate() {
+      seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+   }
+
+   void endUpdate(const itemMonitor& item) {
+      cap.store(item.cap, std::memory_order_relaxed);
+      avail.store(item.avail, std::memory_order_relaxed);
+      seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+   }
+};
+
+
+// a customer whose order was not in stock
+// supply takes the order for it and wakes only this customer
+struct customerWaiter {
+   bool isGranted;            // order was taken for this customer
+   Monitor::Condition granted;
+
+   customerWaiter(Monitor* owner) : granted(owner) {
+      isGranted = false;
+   }
+};
+
+
+// one count per item type, an order or what is left of the stock
+// fixed size for a compile time N, N == 0 is sized when the store is made
+template <int N>
+struct itemCounts {
+   int value[N];
+
+   itemCounts(int) {
+      for (int i = 0; i < N; i++) {
+         value[i] = 0;
       }
    }
+   int& operator[](int i) { return value[i]; }
+};
+
+template <>
+struct itemCounts<0> {
+   std::vector<int> value;
+
+   itemCounts(int count) : value(count, 0) {}
+   int& operator[](int i) { return value[i]; }
+};
 
-   // the call by the supplier threads.
-   void maysupply(int itype, int n) {
-      __synchronized__;
 
-      if (itype == AAA) {
+// store of N item types, indexed 0 .. N-1
+// with N fixed at compile time every loop over the items has a constant bound
+// and is unrolled. storeMonitor<0> takes the number of items at run time
+template <int N>
+class storeMonitor : public Monitor {
 
-         // if n exceeds available capacity, checking if reserved too, wait for capacity to be available
-         while (n > store.capAAA - store.availAAA - reservedAAA) {
-            //std::cout << "supply exceeds available capacity AAA." << std::endl;
-            //std::cout << "waiting for enough capacity" << std::endl;
-            supplierCV[AAA].wait();
-            //std::cout << "capacity available" << std::endl;
+   // inherit from Monitor
+   // the monitor's own lock guards the customer queue,
+   // store state is in the item monitors. lock order: this monitor, then items in index order
+
+   int runtimeCount;          // item types for N == 0
+
+   // struct of arrays, one cache line per item in each
+   itemMonitor* items;        // locks and counters, indexed by item type
+   itemSnapshot* snapshots;   // what monitorStore() reads
+
+   // waiting customers, oldest first
+   // orders are copied next to each other, itemCount() ints per customer,
+   // so a supply scans them without touching the stacks of the waiting customers
+   std::vector<customerWaiter*> waiters;
+   std::vector<int> waitingOrders;
+   std::atomic<int> waiterCount;    // read without lock by buy() as a hint
+
+   int maxOrder;              // set by initStore before other calls, read without lock
+
+   // locks the items of the order one by one in index order, then takes the order if all of it is there
+   // every buyer locks in the same order, so two buyers never wait for each other's locks
+   bool takeOrder(const int* order, int i) {
+      if (i < itemCount()) {
+         if (order[i] == 0) {
+            return takeOrder(order, i + 1);
          }
+         Lock itemLock(&items[i]);
+         return takeOrder(order, i + 1);
+      }
 
+      // all needed items are locked here
+      //checking if order exceeds available stock
+      for (int k = 0; k < itemCount(); k++) {
+         if (order[k] > 0 && order[k] > items[k].avail) {
+            return false;
+         }
+      }
 
-         // may supply is true for AAA item
-         maySupplyAAA = true;
+      for (int k = 0; k < itemCount(); k++) {
+         if (order[k] > 0) {
+            snapshots[k].beginUpdate();
+         }
+      }
 
-         //reserving n amount of AAA as a promise to supply
-         reservedAAA += n;
-         //std::cout << "reserved " << n << " amount of AAA" << std::endl;
+      for (int k = 0; k < itemCount(); k++) {
+         if (order[k] == 0) {
+            continue;
+         }
 
+         // removing items from available stock
+         items[k].avail -= order[k];
+         snapshots[k].endUpdate(items[k]);
 
-         //std::cout << "supplier can supply " << n << " amount of AAA" << std::endl;
+         // update total sold and removed
+         items[k].totalSold += order[k];
+         items[k].totalRemoved += order[k];
 
-         //from hw pdf:
-         //the capacity for n items is reserved for the supplier
-         //Other suppliers of the same item type may block if the remaining capacity is insufficient.
+         // if total sold items doesnt match the total removed
+         if (items[k].totalSold != items[k].totalRemoved) {
+            throw std::runtime_error("sold an removed item count different");
+         }
+
+         //capacity of this item grew, admitting the suppliers it has room for
+         items[k].admitSuppliers();
       }
+      return true;
+   }
 
+   // current stock of every item, each read under its own lock
+   void readStock(itemCounts<N>& left) {
+      for (int i = 0; i < itemCount(); i++) {
+         Lock itemLock(&items[i]);
+         left[i] = items[i].avail;
+      }
+   }
 
-      else if (itype == BBB) {
+   // an order that has to wait keeps what it needs from customers behind it
+   void holdBack(itemCounts<N>& left, const int* order) {
+      for (int i = 0; i < itemCount(); i++) {
+         left[i] -= std::min(order[i], left[i]);
+      }
+   }
 
-         while (n > store.capBBB - store.availBBB - reservedBBB) {
-            //std::cout << "Error: Supply exceeds available capacity BBB." << std::endl;
-            //std::cout << "Waiting for capacity to be available..." << std::endl;
-            supplierCV[BBB].wait();
+   // after a supply of itype, gives stock to waiting customers in arrival order
+   // once an order that needs itype does not fit, later ones get no more itype ahead of it,
+   // and every order that has to wait keeps what it needs from the ones behind it.
+   // a large order is not starved by a stream of small ones
+   // caller holds the monitor lock
+   void grantWaiters(int itype) {
+      int count = itemCount();
+
+      // stock left to give, orders that do not fit are skipped without locking items
+      // stock only grows with another supply, that one scans again after this one
+      itemCounts<N> left(count);
+      readStock(left);
+
+      // granted ones are dropped, the others keep their order
+      // without itype to give, only what a granted order stopped holding back can help later ones
+      size_t kept = 0;
+      size_t w = 0;
+      bool isReleased = false;
+      while (w < waiters.size() && (left[itype] > 0 || isReleased)) {
+         const int* order = &waitingOrders[w * count];
+         bool fits = true;
+         for (int i = 0; i < count; i++) {
+            fits = fits && order[i] <= left[i];
+         }
+         if (!fits || !takeOrder(order, 0)) {
+            std::copy(order, order + count, waitingOrders.begin() + kept * count);
+            waiters[kept++] = waiters[w];
+            w++;
+            if (order[itype] > 0) {
+               left[itype] = 0;
+            }
+            holdBack(left, order);
+            continue;
+         }
+         for (int i = 0; i < count; i++) {
+            left[i] -= order[i];
          }
 
-         reservedBBB += n;
-         //std::cout << "reserved " << n << " amount of BBB" << std::endl;
-         maySupplyBBB = true;
-
-         //std::cout << "supplier can supply " << n << " amount of BBB" << std::endl;
+         // order taken, the customer returns without checking again
+         // customers queued behind it may have waited only for what it held back
+         isReleased = true;
+         waiterCount--;
+         waiters[w]->isGranted = true;
+         waiters[w]->granted.notify();
+         w++;
       }
+      // the rest was not looked at
+      waiters.erase(waiters.begin() + kept, waiters.begin() + w);
+      waitingOrders.erase(waitingOrders.begin() + kept * count, waitingOrders.begin() + w * count);
+   }
 
+   // stock left for order after every waiting customer took what it needs, first come first served
+   // caller holds the monitor lock
+   bool fitsBehindWaiters(const int* order) {
+      if (waiters.empty()) {
+         return true;
+      }
 
-      else if (itype == CCC) {
+      int count = itemCount();
+      itemCounts<N> left(count);
+      readStock(left);
+      for (size_t w = 0; w < waiters.size(); w++) {
+         holdBack(left, &waitingOrders[w * count]);
+      }
 
-         while (n > store.capCCC - store.availCCC - reservedCCC) {
-            //std::cout << "Error: Supply exceeds available capacity CCC" << std::endl;
-            //std::cout << "Waiting for capacity to be available..." << std::endl;
-            supplierCV[CCC].wait();
+      for (int i = 0; i < count; i++) {
+         if (order[i] > left[i]) {
+            return false;
          }
+      }
+      return true;
+   }
 
-         reservedCCC += n;
-         //std::cout << "reserved " << n << " amount of CCC" << std::endl;
-         maySupplyCCC = true;
+   public:
+   //constructor
+   // pass "this" to cv constructors
+   // count is only used for storeMonitor<0>
+   storeMonitor(int count = N) {
+      runtimeCount = count;
+      items = new itemMonitor[itemCount()];
+      snapshots = new itemSnapshot[itemCount()];
+      waiterCount = 0;
+      maxOrder = 0;
+   }
 
-         //std::cout << "supplier can supply " << n << " amount of CCC" << std::endl;
+   ~storeMonitor() {
+      delete[] items;
+      delete[] snapshots;
+   }
+
+   // constant for a compile time N
+   int itemCount() const {
+      return N > 0 ? N : runtimeCount;
+   }
+
+   // will initialize the store with the given parameters.
+   // caps has itemCount() entries
+   void initStore(const int* caps, int mO) {
+      for (int i = 0; i < itemCount(); i++) {
+         Lock itemLock(&items[i]);
+         snapshots[i].beginUpdate();
+         items[i].cap = caps[i];
+
+         // items available
+         items[i].avail = caps[i];
+         snapshots[i].endUpdate(items[i]);
       }
+      maxOrder = mO;
+
+      //std::cout << "max order: " << mO << std::endl;
    }
 
-   // the call by the supplier threads.
-   void supply(int itype, int n) {
+   // the call by the customer threads.
+   // order has itemCount() entries
+   void buy(const int* order) { 
+      //checking if order exceeds limit
+      for (int i = 0; i < itemCount(); i++) {
+         if (order[i] > maxOrder) {
+            //std::cout << "order exceeds  limit" << std::endl;
+            return;
+         }
+      }
+
+      //order is within limit
+
+      // nobody waiting, take it without the queue lock
+      if (waiterCount == 0 && takeOrder(order, 0)) {
+         return;
+      }
+
       __synchronized__;
 
-      if (itype == AAA && maySupplyAAA) {
-         store.availAAA += n;
-         reservedAAA -= n;
-         maySupplyAAA = false;
+      // checked again under the lock, a supply before this point granted nobody to us
+      // customers waiting before us come first: only what their orders leave is ours
+      if (fitsBehindWaiters(order) && takeOrder(order, 0)) {
+         return;
+      }
+
+      //order exceeds available stock, queue up and wait until a supply takes it for us
+      customerWaiter waiter(this);
+      waiters.push_back(&waiter);
+      waitingOrders.insert(waitingOrders.end(), order, order + itemCount());
+      waiterCount++;
+
+      while (!waiter.isGranted) {
+         waiter.granted.wait();
+      }
+   }
+
+   // the call by the supplier threads.
+   void maysupply(int itype, int n) {
+      if (itype < 0 || itype >= itemCount()) {
+         return;
+      }
+      itemMonitor& item = items[itype];
+      Lock itemLock(&item);
 
-         //std::cout << "supplied " << n << " amount of AAA" << std::endl;
-         //std::cout << "new AAA stock: " << store.availAAA << std::endl;
+      // if n exceeds available capacity, checking if reserved too, wait for capacity to be available
+      // waiting suppliers did not fit at the last check, first fit lets this one through
+      if (n <= item.freeCapacity()) {
+         item.reserve(n);
+         return;
       }
 
-      else if (itype == BBB && maySupplyBBB) {
-         store.availBBB += n;
-         reservedBBB -= n;
-         maySupplyBBB = false;
+      //std::cout << "supply exceeds available capacity." << std::endl;
+      // queue up, a buy reserves the capacity for us when it is there
+      supplierWaiter waiter(&item);
+      waitingSupply entry = {n, &waiter};
+      item.suppliers.push_back(entry);
+      item.smallestWaiting = std::min(item.smallestWaiting, n);
+
+      while (!waiter.isAdmitted) {
+         waiter.admitted.wait();
+      }
+   }
 
-         //std::cout << "supplied " << n << " amount of BBB" << std::endl;
-         //std::cout << "new BBB stock: " << store.availBBB << std::endl;
+   // the call by the supplier threads.
+   void supply(int itype, int n) {
+      if (itype < 0 || itype >= itemCount()) {
+         return;
       }
+      itemMonitor& item = items[itype];
 
-      else if (itype == CCC && maySupplyCCC) {
-         store.availCCC += n;
-         reservedCCC -= n;
-         maySupplyCCC = false;
+      {
+         Lock itemLock(&item);
 
-         //std::cout << "supplied " << n << " amount of CCC" << std::endl;
-         //std::cout << "new CCC stock: " << store.availCCC << std::endl;
+         // supply without maysupply is ignored
+         if (item.supplying == 0) {
+            return;
+         }
+         snapshots[itype].beginUpdate();
+         item.avail += n;
+         snapshots[itype].endUpdate(item);
+         item.reserved -= n;
+         item.supplying--;
+
+         //std::cout << "supplied " << n << " amount of " << itype << std::endl;
       }
 
       //unblock customer threads if their orders can now done.
-      customerCV.notifyAll();
+      // only customers that need this item are tried, only granted ones are woken
+      __synchronized__;
+      grantWaiters(itype);
    }
 
-   // puts the current store variables on parameter arrays.
-   void monitorStore(int c[3], int a[3]) {
-      __synchronized__;
+   // puts the current store variables on parameter arrays, itemCount() entries each.
+   // no lock, readers never hold up buyers or suppliers
+   // read again until no item changed during the copy, one consistent view of all items
+   void monitorStore(int* c, int* a) {
+      itemCounts<N> before(itemCount());
+
+      while (true) {
+         bool isChanging = false;
+         for (int i = 0; i < itemCount(); i++) {
+            before[i] = snapshots[i].seq.load(std::memory_order_acquire);
+            isChanging = isChanging || (before[i] & 1);
+         }
 
-      c[0] = store.capAAA;
-      c[1] = store.capBBB;
-      c[2] = store.capCCC;
+         if (!isChanging) {
+            for (int i = 0; i < itemCount(); i++) {
+               c[i] = snapshots[i].cap.load(std::memory_order_relaxed);
+               a[i] = snapshots[i].avail.load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            bool isSame = true;
+            for (int i = 0; i < itemCount(); i++) {
+               isSame = isSame && (int)snapshots[i].seq.load(std::memory_order_relaxed) == before[i];
+            }
+            if (isSame) {
+               return;
+            }
+         }
 
-      a[0] = store.availAAA;
-      a[1] = store.availBBB;
-      a[2] = store.availCCC;
+         // a writer is in the middle, let it finish
+         std::this_thread::yield();
+      }
    }
 };
 
-myMonitor myMonitorObj;
+// run time sized store, for catalogs read from configuration
+// instantiated here so it keeps compiling with the fixed one
+template class storeMonitor<0>;
+
+// AAA, BBB, CCC of hw2.h
+storeMonitor<3> myMonitorObj;
 
 // will initialize the store with the given parameters.
 void initStore(int cA, int cB, int cC, int mO) {
-   myMonitorObj.initStore(cA, cB, cC, mO);
+   int caps[3] = {cA, cB, cC};
+   myMonitorObj.initStore(caps, mO);
 }
 
 // the call by the customer threads.
 void buy(int aA, int aB, int aC) {
-   myMonitorObj.buy(aA, aB, aC);
+   int order[3] = {aA, aB, aC};
+   myMonitorObj.buy(order);
 }
 
 // the call by the supplier threads.
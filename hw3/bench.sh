@@ -0,0 +1,53 @@
+#!/bin/sh
+# generates synthetic images with mkext2img and times histext2fs on them
+#
+#   ./bench.sh                      default configurations below
+#   ./bench.sh "--inodes 50000 --fanout 64" ...    own mkext2img options
+#
+# BENCH_DIR  where images and outputs go (default /tmp/histext2fs-bench)
+# BENCH_ARGS extra histext2fs options, e.g. "--threads 4 --bitmap"
+#
+# the last default configuration has directory entries pointing past the inode
+# table, histext2fs has to get through it like through a clean image
+
+BENCH_DIR=${BENCH_DIR:-/tmp/histext2fs-bench}
+mkdir -p "$BENCH_DIR" || exit 1
+
+if [ $# -eq 0 ]; then
+    set -- \
+        "--inodes 10000 --depth 4 --fanout 32" \
+        "--inodes 100000 --depth 5 --fanout 32 --delete-rate 0.3 --rmdir-rate 0.05" \
+        "--inodes 100000 --depth 2 --fanout 4000 --ghost-density 1.0" \
+        "--inodes 500000 --depth 6 --fanout 24 --delete-rate 0.2 --block-size 4096 --inodes-per-group 16384" \
+        "--inodes 10000 --depth 4 --fanout 32 --delete-rate 0.3 --corrupt-rate 0.01"
+fi
+
+printf "%-8s %6s %9s %9s %9s %9s %9s %9s %9s %9s %10s\n" \
+    config groups load hierarchy index creations deletions timeline syscr syscw maxrss_kb
+
+n=0
+for config in "$@"; do
+    n=$((n + 1))
+    image="$BENCH_DIR/bench$n.img"
+
+    ./mkext2img $config "$image" > "$BENCH_DIR/bench$n.gen" || exit 1
+    ./histext2fs --stats $BENCH_ARGS "$image" "$BENCH_DIR/bench$n.state" "$BENCH_DIR/bench$n.history" \
+        2> "$BENCH_DIR/bench$n.stats" || exit 1
+
+    groups=$(sed -n 's/.* \([0-9]*\) groups.*/\1/p' "$BENCH_DIR/bench$n.gen")
+    awk -v name="bench$n" -v groups="$groups" '
+        $1 == "phase" { phase[$2] = $3 }
+        $1 != "phase" { value[$1] = $2 }
+        END {
+            printf "%-8s %6s %9.4f %9.4f %9.4f %9.4f %9.4f %9.4f %9s %9s %10s\n", name, groups,
+                phase["load"], phase["hierarchy"], phase["index"], phase["creations"],
+                phase["deletions"], phase["timeline"], value["syscr"], value["syscw"], value["maxrss_kb"]
+        }' "$BENCH_DIR/bench$n.stats"
+done
+
+echo
+n=0
+for config in "$@"; do
+    n=$((n + 1))
+    echo "bench$n: $config"
+done
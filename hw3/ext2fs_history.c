@@ -0,0 +1,220 @@
+#include "ext2fs_history.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *actionNames[] = {"mkdir", "touch", "rmdir", "rm"};
+
+void historyInit(struct historyLog *log) {
+
+    memset(log, 0, sizeof(*log));
+    log->events = malloc(HISTORY_RUN_EVENTS * sizeof(struct historyEvent));
+    log->pathsCapacity = 64 * 1024;
+    log->paths = malloc(log->pathsCapacity);
+}
+
+// timestamp first, then the order events came in
+static int compareEvents(const struct historyEvent *a, const struct historyEvent *b) {
+
+    if (a->time != b->time) {
+        return a->time < b->time ? -1 : 1;
+    }
+    if (a->seq != b->seq) {
+        return a->seq < b->seq ? -1 : 1;
+    }
+    return 0;
+}
+
+static int compareEventsQsort(const void *a, const void *b) {
+    return compareEvents(a, b);
+}
+
+// sort what is in memory and move it to a temporary file
+static void spillRun(struct historyLog *log) {
+
+    FILE *run = tmpfile();
+    if (run == NULL) {
+        perror("tmpfile");
+        exit(1);
+    }
+
+    qsort(log->events, log->eventCount, sizeof(struct historyEvent), compareEventsQsort);
+
+    // event header followed by its path bytes
+    for (uint32_t ii = 0; ii < log->eventCount; ii++) {
+        struct historyEvent *event = &log->events[ii];
+
+        fwrite(event, sizeof(*event), 1, run);
+        if (event->pathLength != HISTORY_NO_PATH) {
+            fwrite(log->paths + event->pathOffset, 1, event->pathLength, run);
+        }
+    }
+
+    if (fflush(run) != 0 || ferror(run)) {
+        perror("history spill");
+        exit(1);
+    }
+    rewind(run);
+
+    log->runs = realloc(log->runs, (log->runCount + 1) * sizeof(FILE *));
+    log->runs[log->runCount++] = run;
+
+    log->eventCount = 0;
+    log->pathsSize = 0;
+}
+
+void historyAdd(struct historyLog *log, uint32_t time, enum historyAction action, const char *path, uint32_t parentInode, uint32_t inodeNum) {
+
+    size_t pathLength = path != NULL ? strlen(path) : 0;
+
+    if (log->eventCount == HISTORY_RUN_EVENTS || (log->pathsSize + pathLength > HISTORY_RUN_BYTES && log->eventCount > 0)) {
+        spillRun(log);
+    }
+
+    if (log->pathsSize + pathLength > log->pathsCapacity) {
+        while (log->pathsSize + pathLength > log->pathsCapacity) {
+            log->pathsCapacity *= 2;
+        }
+        log->paths = realloc(log->paths, log->pathsCapacity);
+    }
+
+    struct historyEvent *event = &log->events[log->eventCount++];
+    event->time = time;
+    event->action = action;
+    event->parentInode = parentInode;
+    event->inodeNum = inodeNum;
+    event->seq = log->nextSeq++;
+    event->pathOffset = log->pathsSize;
+    event->pathLength = path != NULL ? pathLength : HISTORY_NO_PATH;
+
+    // events without a path have no bytes to copy
+    if (pathLength > 0) {
+        memcpy(log->paths + log->pathsSize, path, pathLength);
+    }
+    log->pathsSize += pathLength;
+}
+
+// write one event, path points at pathLength bytes
+static void emitEvent(struct outWriter *writer, const struct historyEvent *event, char *path) {
+
+    if (event->pathLength == HISTORY_NO_PATH) {
+        writeHistoryEvent(writer, event->time, actionNames[event->action], NULL, event->parentInode, event->inodeNum);
+        return;
+    }
+
+    // path is not terminated in storage
+    char saved = path[event->pathLength];
+    path[event->pathLength] = '\0';
+    writeHistoryEvent(writer, event->time, actionNames[event->action], path, event->parentInode, event->inodeNum);
+    path[event->pathLength] = saved;
+}
+
+// head of a spilled run during the merge
+struct runHead {
+    FILE *run;
+    struct historyEvent event;
+    char *path;
+    size_t pathCapacity;
+};
+
+// next event of a run, 0 at the end
+static int readRunHead(struct runHead *head) {
+
+    if (fread(&head->event, sizeof(head->event), 1, head->run) != 1) {
+        return 0;
+    }
+
+    size_t length = head->event.pathLength == HISTORY_NO_PATH ? 0 : head->event.pathLength;
+    if (length + 1 > head->pathCapacity) {
+        head->pathCapacity = length + 1;
+        head->path = realloc(head->path, head->pathCapacity);
+    }
+    if (length > 0 && fread(head->path, 1, length, head->run) != length) {
+        return 0;
+    }
+
+    return 1;
+}
+
+// min heap of run heads on the next event of each run
+static void siftDown(struct runHead **heap, uint32_t count, uint32_t index) {
+
+    while (1) {
+        uint32_t smallest = index;
+        uint32_t left = 2 * index + 1;
+        uint32_t right = left + 1;
+
+        if (left < count && compareEvents(&heap[left]->event, &heap[smallest]->event) < 0) {
+            smallest = left;
+        }
+        if (right < count && compareEvents(&heap[right]->event, &heap[smallest]->event) < 0) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+
+        struct runHead *swap = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = swap;
+        index = smallest;
+    }
+}
+
+int historyFinish(struct historyLog *log, struct outWriter *writer) {
+
+    if (log->runCount == 0) {
+        // everything fit in memory, one sorted run
+        qsort(log->events, log->eventCount, sizeof(struct historyEvent), compareEventsQsort);
+
+        // room for the terminator emitEvent puts after a path
+        log->paths = realloc(log->paths, log->pathsSize + 1);
+
+        for (uint32_t ii = 0; ii < log->eventCount; ii++) {
+            emitEvent(writer, &log->events[ii], log->paths + log->events[ii].pathOffset);
+        }
+    }
+    else {
+        if (log->eventCount > 0) {
+            spillRun(log);
+        }
+
+        // k-way merge of the sorted runs
+        struct runHead *heads = calloc(log->runCount, sizeof(struct runHead));
+        struct runHead **heap = malloc(log->runCount * sizeof(struct runHead *));
+        uint32_t heapCount = 0;
+
+        for (uint32_t ii = 0; ii < log->runCount; ii++) {
+            heads[ii].run = log->runs[ii];
+            if (readRunHead(&heads[ii])) {
+                heap[heapCount++] = &heads[ii];
+            }
+        }
+        for (uint32_t ii = heapCount / 2; ii > 0; ii--) {
+            siftDown(heap, heapCount, ii - 1);
+        }
+
+        while (heapCount > 0) {
+            struct runHead *head = heap[0];
+            emitEvent(writer, &head->event, head->path);
+
+            if (!readRunHead(head)) {
+                heap[0] = heap[--heapCount];
+            }
+            siftDown(heap, heapCount, 0);
+        }
+
+        for (uint32_t ii = 0; ii < log->runCount; ii++) {
+            free(heads[ii].path);
+            fclose(log->runs[ii]);
+        }
+        free(heads);
+        free(heap);
+        free(log->runs);
+    }
+
+    free(log->events);
+    free(log->paths);
+
+    return 0;
+}
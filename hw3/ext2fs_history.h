@@ -0,0 +1,55 @@
+#ifndef __EXT2FS_HISTORY_H__
+#define __EXT2FS_HISTORY_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ext2fs_output.h"
+
+// events kept in memory before a sorted run is spilled to a temporary file
+#ifndef HISTORY_RUN_EVENTS
+#define HISTORY_RUN_EVENTS (1 << 18)
+#endif
+// path bytes kept in memory before a spill
+#ifndef HISTORY_RUN_BYTES
+#define HISTORY_RUN_BYTES (32 << 20)
+#endif
+
+enum historyAction {
+    HISTORY_MKDIR,
+    HISTORY_TOUCH,
+    HISTORY_RMDIR,
+    HISTORY_RM,
+};
+
+// one event, its path lives in the run's path buffer or follows it in a spill file
+struct historyEvent {
+    uint32_t time;
+    uint32_t parentInode;
+    uint32_t inodeNum;
+    uint32_t pathLength;    // HISTORY_NO_PATH when the location is unknown
+    uint64_t seq;           // order events were added, breaks timestamp ties
+    uint64_t pathOffset;    // in memory only
+    uint8_t action;
+};
+
+#define HISTORY_NO_PATH UINT32_MAX
+
+// all events of a run, sorted runs are merged by timestamp on finish
+struct historyLog {
+    struct historyEvent *events;
+    uint32_t eventCount;
+    char *paths;
+    size_t pathsSize;
+    size_t pathsCapacity;
+    uint64_t nextSeq;
+
+    FILE **runs;            // spilled sorted runs
+    uint32_t runCount;
+};
+
+void historyInit(struct historyLog *log);
+void historyAdd(struct historyLog *log, uint32_t time, enum historyAction action, const char *path, uint32_t parentInode, uint32_t inodeNum);
+// write every event in timestamp order and release the log
+int historyFinish(struct historyLog *log, struct outWriter *writer);
+
+#endif
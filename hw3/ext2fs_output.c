@@ -0,0 +1,192 @@
+#include "ext2fs_output.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// precomputed run of dashes, depth prefixes are copied out of it
+#define DASH_RUN 256
+static char dashRun[DASH_RUN];
+
+int outOpen(struct outWriter *writer, const char *path, const struct outFormat *format, int isState) {
+
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    writer->buffer = malloc(OUTPUT_BUFFER_SIZE);
+    writer->used = 0;
+    writer->capacity = OUTPUT_BUFFER_SIZE;
+    writer->firstLine = 1;
+    writer->isState = isState;
+    writer->format = format;
+
+    if (dashRun[0] != '-') {
+        memset(dashRun, '-', DASH_RUN);
+    }
+
+    return 0;
+}
+
+// write all bytes, short writes are retried
+static int writeAll(int fd, const char *bytes, size_t length) {
+
+    size_t done = 0;
+
+    while (done < length) {
+        ssize_t written = write(fd, bytes + done, length - done);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("write");
+            return -1;
+        }
+        done += written;
+    }
+
+    return 0;
+}
+
+// write out everything buffered
+int outFlush(struct outWriter *writer) {
+
+    int result = writeAll(writer->fd, writer->buffer, writer->used);
+    writer->used = 0;
+
+    return result;
+}
+
+int outClose(struct outWriter *writer) {
+
+    writer->format->finish(writer, writer->isState);
+
+    int result = outFlush(writer);
+    if (close(writer->fd) < 0) {
+        result = -1;
+    }
+    free(writer->buffer);
+
+    return result;
+}
+
+void outBytes(struct outWriter *writer, const char *bytes, size_t length) {
+
+    if (writer->used + length > writer->capacity) {
+        outFlush(writer);
+
+        // bigger than the whole buffer, skip the copy
+        if (length > writer->capacity) {
+            writeAll(writer->fd, bytes, length);
+            return;
+        }
+    }
+
+    memcpy(writer->buffer + writer->used, bytes, length);
+    writer->used += length;
+}
+
+void outString(struct outWriter *writer, const char *string) {
+    outBytes(writer, string, strlen(string));
+}
+
+void outUnsigned(struct outWriter *writer, uint32_t value) {
+
+    char digits[10];
+    int count = 0;
+
+    do {
+        digits[sizeof(digits) - 1 - count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    outBytes(writer, digits + sizeof(digits) - count, count);
+}
+
+void outDashes(struct outWriter *writer, int count) {
+
+    while (count > 0) {
+        int chunk = count < DASH_RUN ? count : DASH_RUN;
+        outBytes(writer, dashRun, chunk);
+        count -= chunk;
+    }
+}
+
+// newline before every line but the first
+void outNewLine(struct outWriter *writer) {
+
+    if (writer->firstLine) {
+        writer->firstLine = 0;
+        return;
+    }
+    outBytes(writer, "\n", 1);
+}
+
+void writeStateEntry(struct outWriter *writer, int depth, uint32_t inodeNum, const char *name, int isDirectory, int isGhost) {
+    writer->format->stateEntry(writer, depth, inodeNum, name, isDirectory, isGhost);
+}
+
+void writeHistoryEvent(struct outWriter *writer, uint32_t time, const char *action, const char *path, uint32_t parentInode, uint32_t inodeNum) {
+    writer->format->historyEvent(writer, time, action, path, parentInode, inodeNum);
+}
+
+///////////////////////////// text format
+
+// "--- 12:name/", ghosts in parentheses "--- (12:name)"
+static void textStateEntry(struct outWriter *writer, int depth, uint32_t inodeNum, const char *name, int isDirectory, int isGhost) {
+
+    outNewLine(writer);
+    outDashes(writer, depth);
+    outString(writer, isGhost ? " (" : " ");
+    outUnsigned(writer, inodeNum);
+    outBytes(writer, ":", 1);
+    outString(writer, name);
+    if (isDirectory) {
+        outBytes(writer, "/", 1);
+    }
+    if (isGhost) {
+        outBytes(writer, ")", 1);
+    }
+}
+
+// "time action [path] [parent] [inode]", unknown location is "[?] [?]"
+static void textHistoryEvent(struct outWriter *writer, uint32_t time, const char *action, const char *path, uint32_t parentInode, uint32_t inodeNum) {
+
+    outNewLine(writer);
+    outUnsigned(writer, time);
+    outBytes(writer, " ", 1);
+    outString(writer, action);
+
+    if (path != NULL) {
+        outBytes(writer, " [", 2);
+        outString(writer, path);
+        outBytes(writer, "] [", 3);
+        outUnsigned(writer, parentInode);
+        outBytes(writer, "]", 1);
+    }
+    else {
+        outBytes(writer, " [?] [?]", 8);
+    }
+
+    outBytes(writer, " [", 2);
+    outUnsigned(writer, inodeNum);
+    outBytes(writer, "]", 1);
+}
+
+// state file ends with a newline, history does not
+static void textFinish(struct outWriter *writer, int isState) {
+    if (isState) {
+        outBytes(writer, "\n", 1);
+    }
+}
+
+const struct outFormat textFormat = {
+    textStateEntry,
+    textHistoryEvent,
+    textFinish,
+};
@@ -0,0 +1,50 @@
+#ifndef __EXT2FS_OUTPUT_H__
+#define __EXT2FS_OUTPUT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// size of the reusable output buffer, flushed with one write() when full
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+struct outWriter;
+
+// how state lines and history events are turned into bytes
+// text is the only format for now, another one only needs its own table
+struct outFormat {
+    // one entry of the state tree, depth is the number of leading dashes
+    void (*stateEntry)(struct outWriter *writer, int depth, uint32_t inodeNum, const char *name, int isDirectory, int isGhost);
+    // one history event, path NULL when the location is unknown
+    void (*historyEvent)(struct outWriter *writer, uint32_t time, const char *action, const char *path, uint32_t parentInode, uint32_t inodeNum);
+    // called once before the file is closed
+    void (*finish)(struct outWriter *writer, int isState);
+};
+
+struct outWriter {
+    int fd;
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    int firstLine;    // lines are separated, the first one has no newline before it
+    int isState;
+    const struct outFormat *format;
+};
+
+extern const struct outFormat textFormat;
+
+int outOpen(struct outWriter *writer, const char *path, const struct outFormat *format, int isState);
+int outClose(struct outWriter *writer);
+int outFlush(struct outWriter *writer);
+
+// raw appends used by formats
+void outBytes(struct outWriter *writer, const char *bytes, size_t length);
+void outString(struct outWriter *writer, const char *string);
+void outUnsigned(struct outWriter *writer, uint32_t value);
+void outDashes(struct outWriter *writer, int count);
+void outNewLine(struct outWriter *writer);
+
+// entry points used by histext2fs
+void writeStateEntry(struct outWriter *writer, int depth, uint32_t inodeNum, const char *name, int isDirectory, int isGhost);
+void writeHistoryEvent(struct outWriter *writer, uint32_t time, const char *action, const char *path, uint32_t parentInode, uint32_t inodeNum);
+
+#endif
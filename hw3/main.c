@@ -3,33 +3,239 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
 #include "ext2fs.h"
 #include "ext2fs_print.h"
+#include "ext2fs_output.h"
+#include "ext2fs_history.h"
 
-// setting to 300, max path count is around 130 in example 3
-#define PATH_MAX 500
+// zero filled tail after the image, a corrupt entry at the very end reads zeros instead of faulting
+#define IMAGE_TAIL_PAD (64 * 1024)
 
 // global var
 int fd;
-struct ext2_super_block mySuperblock;
-struct ext2_block_group_descriptor *bgdTable;
+char *imageData;    // whole image, read only mapping
+size_t imageSize;
+size_t mappedSize;
+const struct ext2_super_block *mySuperblock;
+const struct ext2_block_group_descriptor *bgdTable;
 uint32_t blockSize;
-FILE *stateOutputFile;
-FILE *historyOutputFile;
-int firstHistoryLine = 1;  // track first line fro empty line
-int firstStateLine = 1;  // track first line
+uint32_t blockGroupCount;
+const char **inodeTables;  // per group pointer into the mapping
+struct outWriter stateOutput;    // buffered, see ext2fs_output.h
+struct outWriter historyOutput;
+struct historyLog history;       // events of all detectors, written sorted by time
 
 // function decl
 uint32_t delParentInode(uint32_t targetInode);
 
-// index loc
-uint32_t inodeLocationCalculation(uint32_t inodeNum) {
+// map the whole image read only
+// superblock, bgdTable, inode tables and directory blocks are all pointers into it
+int mapImage(const char *image) {
 
-    uint32_t blockGrIndex = (inodeNum - 1) / mySuperblock.inodes_per_group;
-    uint32_t indexInGroup = (inodeNum - 1) % mySuperblock.inodes_per_group;
-    uint32_t inodeLocation = bgdTable[blockGrIndex].inode_table * blockSize + (indexInGroup * mySuperblock.inode_size);
-    
-    return inodeLocation;
+    fd = open(image, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < EXT2_SUPER_BLOCK_POSITION + EXT2_SUPER_BLOCK_SIZE) {
+        fprintf(stderr, "%s: not an ext2 image\n", image);
+        return -1;
+    }
+    imageSize = st.st_size;
+
+    // reserve image + tail as zero pages, then put the file over the front of it
+    mappedSize = imageSize + IMAGE_TAIL_PAD;
+    imageData = mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (imageData == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    if (mmap(imageData, imageSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    return 0;
+}
+
+void unmapImage() {
+    munmap(imageData, mappedSize);
+    close(fd);
+}
+
+// madvise on a byte range, start rounded down to a page
+void adviseRange(const char *start, size_t length, int advice) {
+
+    uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)start & ~(pageSize - 1);
+
+    madvise((void *)begin, (uintptr_t)start + length - begin, advice);
+}
+
+// block data, NULL if the block is not inside the image
+char *getBlock(uint32_t blockNum) {
+
+    if ((size_t)blockNum * blockSize + blockSize > imageSize) {
+        return NULL;
+    }
+
+    return imageData + (size_t)blockNum * blockSize;
+}
+
+// point at each group's inode table inside the mapping
+// tables are scanned front to back, so ask the kernel to read them ahead
+void loadInodeTables() {
+
+    size_t groupBytes = (size_t)mySuperblock->inodes_per_group * mySuperblock->inode_size;
+
+    inodeTables = malloc(blockGroupCount * sizeof(char *));
+
+    for (uint32_t group = 0; group < blockGroupCount; group++) {
+        size_t tablePos = (size_t)bgdTable[group].inode_table * blockSize;
+
+        if (tablePos + groupBytes > imageSize) {
+            // truncated image, group has no readable inodes
+            inodeTables[group] = NULL;
+            continue;
+        }
+
+        inodeTables[group] = imageData + tablePos;
+        adviseRange(inodeTables[group], groupBytes, MADV_SEQUENTIAL);
+        adviseRange(inodeTables[group], groupBytes, MADV_WILLNEED);
+    }
+}
+
+// inode inside the mapping, NULL if number is out of range
+struct ext2_inode *getInode(uint32_t inodeNum) {
+
+    if (inodeNum == 0 || inodeNum > mySuperblock->inode_count) {
+        return NULL;
+    }
+
+    uint32_t blockGrIndex = (inodeNum - 1) / mySuperblock->inodes_per_group;
+    uint32_t indexInGroup = (inodeNum - 1) % mySuperblock->inodes_per_group;
+
+    if (blockGrIndex >= blockGroupCount || inodeTables[blockGrIndex] == NULL) {
+        return NULL;
+    }
+
+    return (struct ext2_inode *)(inodeTables[blockGrIndex] + (size_t)indexInGroup * mySuperblock->inode_size);
+}
+
+// run of consecutive blocks
+struct blockExtent {
+    uint32_t start;
+    uint32_t count;
+};
+
+// data blocks of an inode, direct and indirect, coalesced into runs
+struct blockIterator {
+    struct blockExtent *extents;
+    uint32_t extentCount;
+    uint32_t extentCapacity;
+    uint32_t currentExtent;   // run being walked
+    uint32_t currentOffset;   // block inside that run
+};
+
+// append a block, grows the last run if it is the next block on disk
+void addBlockToRuns(struct blockIterator *blocks, uint32_t blockNum) {
+
+    if (blocks->extentCount > 0) {
+        struct blockExtent *last = &blocks->extents[blocks->extentCount - 1];
+        if (last->start + last->count == blockNum) {
+            last->count++;
+            return;
+        }
+    }
+
+    if (blocks->extentCount == blocks->extentCapacity) {
+        blocks->extentCapacity = blocks->extentCapacity ? blocks->extentCapacity * 2 : 16;
+        blocks->extents = realloc(blocks->extents, blocks->extentCapacity * sizeof(struct blockExtent));
+    }
+
+    blocks->extents[blocks->extentCount].start = blockNum;
+    blocks->extents[blocks->extentCount].count = 1;
+    blocks->extentCount++;
+}
+
+// blocks behind an indirect block, level 1 single, 2 double, 3 triple
+void addIndirectBlocks(struct blockIterator *blocks, uint32_t pointerBlock, int level) {
+
+    const uint32_t *pointers = (const uint32_t *)getBlock(pointerBlock);
+    if (pointers == NULL) {
+        return;
+    }
+
+    for (uint32_t ii = 0; ii < blockSize / sizeof(uint32_t); ii++) {
+
+        // holes are skipped, same as direct blocks
+        if (pointers[ii] == 0) {
+            continue;
+        }
+
+        if (level == 1) {
+            addBlockToRuns(blocks, pointers[ii]);
+        }
+        else {
+            addIndirectBlocks(blocks, pointers[ii], level - 1);
+        }
+    }
+}
+
+// resolve the whole block map of an inode up front
+void startBlockIterator(struct blockIterator *blocks, const struct ext2_inode *inode) {
+
+    memset(blocks, 0, sizeof(*blocks));
+
+    for (int ii = 0; ii < EXT2_NUM_DIRECT_BLOCKS; ii++) {
+        if (inode->direct_blocks[ii] != 0) {
+            addBlockToRuns(blocks, inode->direct_blocks[ii]);
+        }
+    }
+
+    if (inode->single_indirect != 0) {
+        addIndirectBlocks(blocks, inode->single_indirect, 1);
+    }
+    if (inode->double_indirect != 0) {
+        addIndirectBlocks(blocks, inode->double_indirect, 2);
+    }
+    if (inode->triple_indirect != 0) {
+        addIndirectBlocks(blocks, inode->triple_indirect, 3);
+    }
+}
+
+// next block number, 0 when done
+// entering a run of more than one block asks the kernel for the whole run at once
+uint32_t nextBlock(struct blockIterator *blocks) {
+
+    while (blocks->currentExtent < blocks->extentCount) {
+        struct blockExtent *run = &blocks->extents[blocks->currentExtent];
+
+        if (blocks->currentOffset < run->count) {
+
+            if (blocks->currentOffset == 0 && run->count > 1 && getBlock(run->start + run->count - 1) != NULL) {
+                adviseRange(getBlock(run->start), (size_t)run->count * blockSize, MADV_WILLNEED);
+            }
+
+            return run->start + blocks->currentOffset++;
+        }
+
+        blocks->currentExtent++;
+        blocks->currentOffset = 0;
+    }
+
+    return 0;
+}
+
+void endBlockIterator(struct blockIterator *blocks) {
+    free(blocks->extents);
 }
 
 // name = entry->name
@@ -46,20 +252,15 @@ void copyEntryName(const struct ext2_dir_entry *entry, char *name) {
 
 // check inode is directory
 int isDirectory(uint32_t inodeNum) {
-    if (inodeNum == 0) {
+    // inode data
+    struct ext2_inode *inodeData = getInode(inodeNum);
+    if (inodeData == NULL) {
         return 0;
     }
-
-    // inode location
-    uint32_t indexLoc = inodeLocationCalculation(inodeNum);
-    
-    // inode data
-    struct ext2_inode inodeData;
-    pread(fd, &inodeData, sizeof(inodeData), indexLoc);
     
     // check mode
     // from ext2fs.h
-    if (inodeData.mode & EXT2_I_DTYPE) {
+    if (inodeData->mode & EXT2_I_DTYPE) {
         return 1;  // directory
     }
     else {
@@ -78,30 +279,25 @@ void displayHierarchy(uint32_t inodeNum, int depth)
         return;
     }
     
-    // inode location
-    uint32_t inodeLoc = inodeLocationCalculation(inodeNum);
-
     //inode data
-    struct ext2_inode inode;
-    pread(fd, &inode, sizeof(inode), inodeLoc);
+    struct ext2_inode *inode = getInode(inodeNum);
+    if (inode == NULL) {
+        return;
+    }
 
-    // for each block
+    // for each block, direct and indirect
     // printf("iterating over blocks for inode %u\n", inodeNum);
-    for (int ii = 0; ii < EXT2_NUM_DIRECT_BLOCKS; ii++) {
+    struct blockIterator blocks;
+    startBlockIterator(&blocks, inode);
 
-        // if block is 0, skip it
-        if (inode.direct_blocks[ii] == 0) {
-            continue; 
-        }
-
-        // calculate the block pos
-        uint32_t blockPos = inode.direct_blocks[ii] * blockSize;
+    uint32_t blockNum;
+    while ((blockNum = nextBlock(&blocks)) != 0) {
 
-        // data holds directory block data
-        char *data = malloc(blockSize);
-
-        // read the directory block
-        pread(fd, data, blockSize, blockPos);
+        // data points at the directory block in the mapping
+        char *data = getBlock(blockNum);
+        if (data == NULL) {
+            continue;
+        }
 
         // offset to process directory entries
         uint32_t position = 0;
@@ -149,7 +345,7 @@ void displayHierarchy(uint32_t inodeNum, int depth)
                     struct ext2_dir_entry *ghostEntry = (struct ext2_dir_entry *)(data + ghostPos);
                     
                     // check if valid ghost entry - simplified validation
-                    if (ghostEntry->inode > 0 && ghostEntry->inode <= mySuperblock.inode_count && ghostEntry->name_length > 0) {
+                    if (ghostEntry->inode > 0 && ghostEntry->inode <= mySuperblock->inode_count && ghostEntry->name_length > 0) {
 
                         char ghostName[EXT2_MAX_NAME_LENGTH + 1]; // +1 for null terminator
 
@@ -160,30 +356,8 @@ void displayHierarchy(uint32_t inodeNum, int depth)
                         if (ghostName[0] != '.' || (ghostEntry->name_length != 1 && 
                             !(ghostEntry->name_length == 2 && ghostName[1] == '.'))) {
 
-                            
-                            if (firstStateLine) {
-                                // dashes for depth
-                                // no newline at beginning for first line
-                                for (int iii = 0; iii < depth; iii++) {
-                                    fprintf(stateOutputFile, "-");
-                                }
-                                firstStateLine = 0;  // not first line anymore
-                            } else {
-                                // newline at beginning for other lines
-                                fprintf(stateOutputFile, "\n");
-                                for (int iiii = 0; iiii < depth; iiii++) {
-                                    fprintf(stateOutputFile, "-");
-                                }
-                            }
-
-                            // check is directory or file
-                            if (isDirectory(ghostEntry->inode)) {
-                                fprintf(stateOutputFile, " (%u:%s/)", ghostEntry->inode, ghostName);
-                            } 
-                            // file
-                            else {
-                                fprintf(stateOutputFile, " (%u:%s)", ghostEntry->inode, ghostName);
-                            }
+                            // ghost line, directory or file
+                            writeStateEntry(&stateOutput, depth, ghostEntry->inode, ghostName, isDirectory(ghostEntry->inode), 1);
                         }
                         ghostPos += ghostEntry->length;
                     }
@@ -220,34 +394,18 @@ void displayHierarchy(uint32_t inodeNum, int depth)
                     continue;
                 }
                 
-                if (firstStateLine) {
-                    // dashes for depth
-                    // no newline at beginning for first line
-                    for (int kk = 0; kk < depth; kk++) {
-                        fprintf(stateOutputFile, "-");
-                    }
-                    firstStateLine = 0;  // not first line anymore
-                } 
-                else {
-                    // newline at beginning for other lines
-                    fprintf(stateOutputFile, "\n");
-                    for (int kk = 0; kk < depth; kk++) {
-                        fprintf(stateOutputFile, "-");
-                    }
-                }
-                
                 // check if directory or file
                 if (isDirectory(entry->inode)) 
                 {
 
-                    fprintf(stateOutputFile, " %u:%s/", entry->inode, name);
+                    writeStateEntry(&stateOutput, depth, entry->inode, name, 1, 0);
 
                     //recursive
                     displayHierarchy(entry->inode, depth +1);
                 } 
                 // file
                 else {
-                    fprintf(stateOutputFile, " %u:%s", entry->inode , name);
+                    writeStateEntry(&stateOutput, depth, entry->inode, name, 0, 0);
                 }
             }
             position +=entry->length;
@@ -255,8 +413,8 @@ void displayHierarchy(uint32_t inodeNum, int depth)
         
         //debug
         //printf("finished processing block \n");
-        free(data);
     }
+    endBlockIterator(&blocks);
     
     ///debug
     //printf("finished processing inode \n");
@@ -266,631 +424,774 @@ void displayHierarchy(uint32_t inodeNum, int depth)
 
 
 
-////////////////////////////// history part
+////////////////////////////// group scanning
 
-// delete structure
-struct deletion {
-    uint32_t inodeNum;
-    uint32_t deletionTime;
-    int isDirectory;
-    char path[PATH_MAX]; // path to the deleted file or directory
-    uint32_t parentInode;
-    int foundLocation;
-};
+// number of scanning threads, --threads N
+int threadCount = 1;
 
+// first and last inode number of a block group
+uint32_t firstInodeOfGroup(uint32_t group) {
+    return group * mySuperblock->inodes_per_group + 1;
+}
 
-// structure for mkdir and touch
-struct mkdirTouch {
-    uint32_t inodeNum;
-    uint32_t creationTime;
-    int isDirectory;
-    char path[PATH_MAX];
-    uint32_t parentInode;
-    int foundLocation;
-};
+uint32_t lastInodeOfGroup(uint32_t group) {
+    uint32_t last = (group + 1) * mySuperblock->inodes_per_group;
+    return last < mySuperblock->inode_count ? last : mySuperblock->inode_count;
+}
 
+// --bitmap: trust the inode and block bitmaps while scanning
+int bitmapMode = 0;
+const uint8_t **inodeBitmaps;   // per group pointer into the mapping, NULL if unreadable
+const uint8_t **blockBitmaps;
 
-// find directory path from inode
-void findPath(uint32_t targetInode, uint32_t currentInode, char* currentPath, char* resultPath, int* found) {
+// which inode slots a scan looks at in bitmap mode
+#define SCAN_ALLOCATED 1
+#define SCAN_FREE      2   // only free slots that were used once, i.e. deleted inodes
 
-    // check doing this in directoryHierarchy ??
-    
-    if (*found || currentInode == 0) {
-        return;
+void loadBitmaps() {
+
+    inodeBitmaps = malloc(blockGroupCount * sizeof(uint8_t *));
+    blockBitmaps = malloc(blockGroupCount * sizeof(uint8_t *));
+
+    for (uint32_t group = 0; group < blockGroupCount; group++) {
+        inodeBitmaps[group] = (const uint8_t *)getBlock(bgdTable[group].inode_bitmap);
+        blockBitmaps[group] = (const uint8_t *)getBlock(bgdTable[group].block_bitmap);
     }
-    
-    // calculate inode location
-    uint32_t inodeLocation = inodeLocationCalculation(currentInode);
-    
-    // read inode
-    struct ext2_inode inode;
-    pread(fd, &inode, sizeof(inode), inodeLocation);
-    
-    // only directories
-    if (!(inode.mode & EXT2_I_DTYPE)) {
-        return;
+}
+
+void freeBitmaps() {
+    free(inodeBitmaps);
+    free(blockBitmaps);
+}
+
+// bit of a bitmap
+int bitmapBit(const uint8_t *bitmap, uint32_t index) {
+    return (bitmap[index / 8] >> (index % 8)) & 1;
+}
+
+// 64 bits of a bitmap starting at bit wordIndex * 64, bits past bitCount are zero
+uint64_t bitmapWord(const uint8_t *bitmap, uint32_t wordIndex, uint32_t bitCount) {
+
+    uint32_t firstBit = wordIndex * 64;
+    uint32_t bits = bitCount - firstBit < 64 ? bitCount - firstBit : 64;
+    uint64_t word = 0;
+
+    // bitmaps are little endian, byte n holds bits 8n..8n+7
+    memcpy(&word, bitmap + firstBit / 8, (bits + 7) / 8);
+
+    if (bits < 64) {
+        word &= (1ULL << bits) - 1;
     }
-    
-    // for each block in directory
-    for (int ii = 0; ii < EXT2_NUM_DIRECT_BLOCKS; ii++) {
-        
-        if (inode.direct_blocks[ii] == 0) {
-            continue;
+    return word;
+}
+
+int isInodeAllocated(uint32_t inodeNum) {
+
+    uint32_t group = (inodeNum - 1) / mySuperblock->inodes_per_group;
+    if (!bitmapMode || group >= blockGroupCount || inodeBitmaps[group] == NULL) {
+        return 1;
+    }
+    return bitmapBit(inodeBitmaps[group], (inodeNum - 1) % mySuperblock->inodes_per_group);
+}
+
+int isBlockInUse(uint32_t blockNum) {
+
+    if (!bitmapMode || blockNum < mySuperblock->first_data_block) {
+        return 1;
+    }
+
+    uint32_t index = blockNum - mySuperblock->first_data_block;
+    uint32_t group = index / mySuperblock->blocks_per_group;
+    if (group >= blockGroupCount || blockBitmaps[group] == NULL) {
+        return 1;
+    }
+    return bitmapBit(blockBitmaps[group], index % mySuperblock->blocks_per_group);
+}
+
+// free slot that has been used, never used slots are all zero
+int isUsedFreeSlot(const struct ext2_inode *inode) {
+    return inode->deletion_time != 0 || inode->mode != 0;
+}
+
+// walks the inode slots of one group that a scan cares about
+struct slotCursor {
+    uint32_t firstInode;  // inode number of slot 0
+    uint32_t slotCount;
+    uint32_t next;        // next slot, linear mode
+    int slots;            // SCAN_ALLOCATED and/or SCAN_FREE
+    const uint8_t *bitmap;
+    uint32_t wordIndex;   // next bitmap word to load
+    uint64_t allocated;   // allocated bits of the loaded word
+    uint64_t pending;     // candidate bits of the loaded word not handed out yet
+};
+
+void startSlotCursor(struct slotCursor *cursor, uint32_t group, int slots) {
+
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->firstInode = firstInodeOfGroup(group);
+    cursor->slotCount = lastInodeOfGroup(group) - cursor->firstInode + 1;
+    cursor->slots = slots;
+
+    // without bitmaps every slot is walked
+    if (bitmapMode) {
+        cursor->bitmap = inodeBitmaps[group];
+    }
+}
+
+// next inode number, 0 when the group is done
+// bitmap mode walks set bits of each 64 slot word with ctz, free slots are checked for leftovers
+uint32_t nextSlot(struct slotCursor *cursor) {
+
+    if (cursor->bitmap == NULL) {
+        if (cursor->next < cursor->slotCount) {
+            return cursor->firstInode + cursor->next++;
         }
-        
-        uint32_t directoryBlockPosition = inode.direct_blocks[ii] * blockSize;
-        char *data = malloc(blockSize);
-        pread(fd, data, blockSize, directoryBlockPosition);
-        
-        uint32_t position = 0;
-        
-        while (position < blockSize && !*found) {
-            struct ext2_dir_entry *entry = (struct ext2_dir_entry *)(data + position);
-            
-            if (entry->length == 0 || entry->length < EXT2_DIR_ENTRY_HEADER_SIZE) {
-                break;
+        return 0;
+    }
+
+    while (1) {
+        while (cursor->pending == 0) {
+            if (cursor->wordIndex * 64 >= cursor->slotCount) {
+                return 0;
             }
-            
-            // check ghost entries
-            uint32_t expectedLength = EXT2_DIR_LENGTH(entry->name_length);
-            
-            if (expectedLength <= entry->length && entry->length > expectedLength + EXT2_DIR_ENTRY_HEADER_SIZE) {
-                
-                uint32_t ghostPos = position + expectedLength;
-                
-                // align to 4 bytes
-                while (ghostPos % 4 != 0) {
-                    ghostPos++;
-                }
-                
-                // search for ghost entries
-                while (ghostPos + EXT2_DIR_ENTRY_HEADER_SIZE <= position + entry->length && ghostPos < blockSize) {
-                    struct ext2_dir_entry *ghostEntry = (struct ext2_dir_entry *)(data + ghostPos);
-                    
-                    if (ghostEntry->inode == targetInode && ghostEntry->inode > 0 && 
-                        ghostEntry->inode <= mySuperblock.inode_count && 
-                        ghostEntry->name_length > 0 && ghostEntry->name_length <= EXT2_MAX_NAME_LENGTH) {
-                        
-                        char ghostName[EXT2_MAX_NAME_LENGTH + 1];
-                        // int j ;
-                        
-                        // cahnged to helper function
-                        copyEntryName(ghostEntry, ghostName);
-                        
-                        // skip . and .. entries
-                        if (ghostName[0] != '.' || (ghostEntry->name_length != 1 && !(ghostEntry->name_length == 2 && ghostName[1] == '.'))) {
-                            
-                            // found target inode
-                            // building path with ghost name
-                            if (strlen(currentPath) == 0) {
-                                // if current path is empty, im at root
-                                // path is just /filename
-                                sprintf(resultPath, "/%s", ghostName);
-                            } 
-                            else {
-                                //path is not empty, add ghost name
-                                // current path + / + filename
-                                sprintf(resultPath, "%s/%s", currentPath, ghostName);
-                            }
-
-                            *found = 1;
-                            free(data);
-                            return;
-                        }
-                    }
-                    
-                    if (ghostEntry->length > 0) {
-                        ghostPos += ghostEntry->length;
-                    } else {
-                        ghostPos += 4;
-                    }
-                }
+
+            uint64_t valid = ~0ULL;
+            uint32_t bits = cursor->slotCount - cursor->wordIndex * 64;
+            if (bits < 64) {
+                valid = (1ULL << bits) - 1;
             }
-            
-            // check regular entries
-            if (entry->inode != 0) {
-                
-                char name[EXT2_MAX_NAME_LENGTH + 1];
-                
-                // copy to name
-                copyEntryName(entry, name);
-                
 
-                // skip . and .. entries
-                if (name[0] == '.' && (entry->name_length == 1 || (entry->name_length == 2 && name[1] == '.'))) {
-                    position += entry->length;
-                    continue;
-                }
-                
-                // if found target inode in regular entries
-                if (entry->inode == targetInode) {
-
-                    // do complete file path
-                    // directory path with file name
-                    if (strlen(currentPath) == 0) {
-                        // at root, path is just /filename
-                        sprintf(resultPath, "/%s", name);
-                    } 
-                    else {
-                        // in a subdirectory, add path
-                        sprintf(resultPath, "%s/%s", currentPath, name);
-                    }
-                    *found = 1;
-                    free(data);
-                    return;
-                }
-                
-                // if directory, recurse
-                if (isDirectory(entry->inode)) {
-                    // found a subdirectory, search inside
-                    // build  path to this subdirectory
-                    char newPath[PATH_MAX];
-                    
-                    if (strlen(currentPath) == 0) {
-                        // at root, new path is /directoryName
-                        sprintf(newPath, "/%s", name);
-                    } 
-                    else {
-                        // path is not empty, add ghost name
-                        sprintf(newPath, "%s/%s", currentPath, name);
-                    }
-                    
-                    // search inside this subdirectory recursively
-                    findPath(targetInode, entry->inode, newPath, resultPath, found);
-                }
+            cursor->allocated = bitmapWord(cursor->bitmap, cursor->wordIndex, cursor->slotCount);
+            cursor->pending = 0;
+            if (cursor->slots & SCAN_ALLOCATED) {
+                cursor->pending |= cursor->allocated;
             }
-            position += entry->length;
-        }
-        
-        free(data);
-    }
-    
-    // checking ghost directories, all deleted directory inodes
-    for (uint32_t checkInode = 1; checkInode <= mySuperblock.inode_count; checkInode++) {
-        
-        if (checkInode == currentInode) {
-            continue;
+            if (cursor->slots & SCAN_FREE) {
+                cursor->pending |= ~cursor->allocated & valid;
+            }
+            cursor->wordIndex++;
         }
-        
-        // calculate inode location for ghost dir
-        uint32_t checkInodeLocation = inodeLocationCalculation(checkInode);
-        
-        struct ext2_inode checkInodeData;
-        pread(fd, &checkInodeData, sizeof(checkInodeData), checkInodeLocation);
-        
-        // check if deleted directory was in current directory
-        if (checkInodeData.deletion_time > 0 && (checkInodeData.mode & EXT2_I_DTYPE)) {
-            
-            uint32_t foundParent = delParentInode(checkInode);
-            if (foundParent == currentInode) {
-                
-                // deleted directory name
-                char deletedDirName[EXT2_MAX_NAME_LENGTH + 1];
-                int foundName = 0;
-                
-                // check current directory for ghost entry of deleted directory
-                for (int i3 = 0; i3 < EXT2_NUM_DIRECT_BLOCKS && !foundName; i3++) {
-                    
-                    if (inode.direct_blocks[i3] == 0) {
-                        continue;
-                    }
-                    
-                    uint32_t directoryBlockPosition = inode.direct_blocks[i3] * blockSize;
-                    char *data = malloc(blockSize);
-                    pread(fd, data, blockSize, directoryBlockPosition);
-                    
-                    uint32_t position = 0;
-                    
-                    while (position < blockSize && !foundName) {
-                        
-                        struct ext2_dir_entry *entry = (struct ext2_dir_entry *)(data + position);
-                        
-                        if (entry->length == 0 || entry->length < EXT2_DIR_ENTRY_HEADER_SIZE) {
-                            break;
-                        }
-                        
-                        // check for ghost entries
-                        uint32_t expectedLength = EXT2_DIR_LENGTH(entry->name_length);
-                        
-                        if (expectedLength <= entry->length && entry->length > expectedLength + EXT2_DIR_ENTRY_HEADER_SIZE) {
-                            
-                            uint32_t ghostPos = position + expectedLength;
-                            
-                            // align to 4 bytes
-                            while (ghostPos % 4 != 0) {
-                                ghostPos++;
-                            }
-                            
-                            // search for ghost entries
-                            while (ghostPos + EXT2_DIR_ENTRY_HEADER_SIZE <= position + entry->length && ghostPos < blockSize) {
-                                
-                                struct ext2_dir_entry *ghostEntry = (struct ext2_dir_entry *)(data + ghostPos);
-                                
-                                if (ghostEntry->inode == checkInode && ghostEntry->inode > 0 && 
-                                    ghostEntry->inode <= mySuperblock.inode_count && 
-                                    ghostEntry->name_length > 0 && ghostEntry->name_length <= EXT2_MAX_NAME_LENGTH) {
-                                    
-                                    char ghostName[EXT2_MAX_NAME_LENGTH + 1];
-                                    
-                                    // changed to helper function
-                                    copyEntryName(ghostEntry, ghostName);
-                                    
-                                    // skip . and .. entries
-                                    if (ghostName[0] != '.' || (ghostEntry->name_length != 1 && 
-                                        !(ghostEntry->name_length == 2 && ghostName[1] == '.'))) {
-                                        
-                                        // copy ghostName to deletedDirName
-                                        int i5;
-                                        for (i5 = 0; i5 < ghostEntry->name_length; i5++) {
-                                            deletedDirName[i5] = ghostName[i5];
-                                        }
-                                        deletedDirName[i5] = '\0'; // null terminate
-                                        
-                                        foundName = 1;
-                                        break;
-                                    }
-                                }
-                                
-                                if (ghostEntry->length > 0) {
-                                    ghostPos += ghostEntry->length;
-                                } else {
-                                    ghostPos += 4;
-                                }
-                            }
-                        }
-                        
-                        position += entry->length;
-                    }
-                    
-                    free(data);
-                }
-                
-                // name found, recurse deleted directory
-                if (foundName) {
 
-                    char newPath[PATH_MAX];
+        int bit = __builtin_ctzll(cursor->pending);
+        uint64_t mask = 1ULL << bit;
+        cursor->pending &= cursor->pending - 1;
 
-                    if (strlen(currentPath) == 0) {
-                        sprintf(newPath, "/%s", deletedDirName);
-                    } 
-                    else {
-                        sprintf(newPath, "%s/%s", currentPath, deletedDirName);
-                    }
+        uint32_t inodeNum = cursor->firstInode + (cursor->wordIndex - 1) * 64 + bit;
 
-                    findPath(targetInode, checkInode, newPath, resultPath, found);
-                }
-            }
+        if (cursor->allocated & mask) {
+            return inodeNum;
+        }
+
+        // free slot, only worth it if something was left behind
+        struct ext2_inode *inode = getInode(inodeNum);
+        if (inode != NULL && isUsedFreeSlot(inode)) {
+            return inodeNum;
         }
     }
 }
 
-// find parent directory inode for deleted entry
-uint32_t delParentInode(uint32_t targetInode) {
+// shared state of one forEachGroup call
+struct groupWork {
+    void (*work)(uint32_t group, void *context);
+    void *context;
+    uint32_t nextGroup;   // next group to hand out, taken atomically
+};
 
-    // find inode location
-    for (uint32_t inodeNum = 1; inodeNum <= mySuperblock.inode_count; inodeNum++) {
-        if (!isDirectory(inodeNum)) {
-            continue;
+void *groupWorker(void *arg) {
+
+    struct groupWork *shared = arg;
+
+    while (1) {
+        uint32_t group = __atomic_fetch_add(&shared->nextGroup, 1, __ATOMIC_RELAXED);
+        if (group >= blockGroupCount) {
+            break;
         }
-        
-        // calculate inode location
-        uint32_t inodeLocation = inodeLocationCalculation(inodeNum);
-        
-        struct ext2_inode inode;
-        pread(fd, &inode, sizeof(inode), inodeLocation);
-        
-        // search for ghost entries
-        for (int i6 = 0; i6 < EXT2_NUM_DIRECT_BLOCKS; i6++) {
-            
-            if (inode.direct_blocks[i6] == 0) {
-                continue;
-            }
-            
-            uint32_t directoryBlockPosition = inode.direct_blocks[i6] * blockSize;
-            char *data = malloc(blockSize);
-            pread(fd, data, blockSize, directoryBlockPosition);
-            
-            uint32_t position = 0;
-            
-            while (position < blockSize) {
-                
-                struct ext2_dir_entry *entry = (struct ext2_dir_entry *)(data + position);
-                
-                if (entry->length == 0 || entry->length < EXT2_DIR_ENTRY_HEADER_SIZE) {
-                    break;
-                }
-                
-                // check for ghost entries
-                uint32_t expectedLength = EXT2_DIR_LENGTH(entry->name_length);
-                
-                if (expectedLength <= entry->length && entry->length > expectedLength + EXT2_DIR_ENTRY_HEADER_SIZE) {
-                    
-                    uint32_t ghostPos = position + expectedLength;
-                    
-                    // align to 4 bytes
-                    while (ghostPos % 4 != 0) {
-                        ghostPos++;
-                    }
-                    
-                    // search for ghost entries
-                    while (ghostPos + EXT2_DIR_ENTRY_HEADER_SIZE <= position + entry->length && ghostPos < blockSize) {
-                        
-                        struct ext2_dir_entry *ghostEntry = (struct ext2_dir_entry *)(data + ghostPos);
-                        
-                        if (ghostEntry->inode == targetInode && ghostEntry->inode > 0 && 
-                            ghostEntry->inode <= mySuperblock.inode_count && 
-                            ghostEntry->name_length > 0 && ghostEntry->name_length <= EXT2_MAX_NAME_LENGTH) {
-                            
-                            free(data);
-                            return inodeNum;
-                        }
-                        
-                        if (ghostEntry->length > 0) {
-                            ghostPos += ghostEntry->length;
-                        } 
-                        else {
-                            ghostPos += 4;
-                        }
-                    }
-                }
-                
-                position += entry->length;
-            }
-            
-            free(data);
+        shared->work(group, shared->context);
+    }
+
+    return NULL;
+}
+
+// run work once for every block group, spread over threadCount threads
+// groups are independent, work must only write to its own group's slot in context
+void forEachGroup(void (*work)(uint32_t group, void *context), void *context) {
+
+    struct groupWork shared = {work, context, 0};
+
+    int workers = threadCount;
+    if ((uint32_t)workers > blockGroupCount) {
+        workers = blockGroupCount;
+    }
+
+    // calling thread takes part, so one thread means no pthreads at all
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    int started = 0;
+
+    for (int ii = 1; ii < workers; ii++) {
+        if (pthread_create(&threads[started], NULL, groupWorker, &shared) == 0) {
+            started++;
         }
     }
-    
-    return 0; // not found
+
+    groupWorker(&shared);
+
+    for (int ii = 0; ii < started; ii++) {
+        pthread_join(threads[ii], NULL);
+    }
+    free(threads);
 }
 
-// find deleted files and their locations
-void deletedFiles() {
-    
-    // store deletion info
-    // check 1000 later ???
-    struct deletion deletions[PATH_MAX]; 
-    int deletionCount = 0;
-    
-    // find all deleted inodes
-    for (uint32_t inodeNum = 1; inodeNum <= mySuperblock.inode_count; inodeNum++) {
-        // calculate inode location
-        uint32_t inodeLoc = inodeLocationCalculation(inodeNum);
-        
-        // read inode
-        struct ext2_inode tempInode;
-        pread(fd, &tempInode, sizeof(tempInode), inodeLoc);
-        
-        // check if was deleted
-        if (tempInode.deletion_time > 0 && deletionCount < PATH_MAX) {
-            
-            // store deletion info
-            deletions[deletionCount].inodeNum = inodeNum;
-            deletions[deletionCount].deletionTime = tempInode.deletion_time;
-            
-            // check if directory or file
-            if (tempInode.mode & EXT2_I_DTYPE) {
-                deletions[deletionCount].isDirectory = 1;
-            } 
-            else {
-                deletions[deletionCount].isDirectory = 0;
-            }
-            
-            deletions[deletionCount].foundLocation = 0;
-            deletions[deletionCount].parentInode = 0;
-            
-            deletions[deletionCount].path[0] = '?';
-            deletions[deletionCount].path[1] = '\0';
-            
-            deletionCount++;
+// inode numbers of one group that matched a scan
+struct inodeList {
+    uint32_t *inodes;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+// shared state of one collectInodes call
+struct inodeScan {
+    int (*match)(uint32_t inodeNum, const struct ext2_inode *inode);
+    uint32_t firstInode;
+    int slots;
+    struct inodeList *lists;   // one per group
+};
+
+void scanGroup(uint32_t group, void *context) {
+
+    struct inodeScan *scan = context;
+    struct inodeList *list = &scan->lists[group];
+
+    struct slotCursor cursor;
+    startSlotCursor(&cursor, group, scan->slots);
+
+    uint32_t inodeNum;
+    while ((inodeNum = nextSlot(&cursor)) != 0) {
+        struct ext2_inode *inode = getInode(inodeNum);
+
+        if (inodeNum < scan->firstInode || inode == NULL || !scan->match(inodeNum, inode)) {
+            continue;
         }
+
+        if (list->count == list->capacity) {
+            list->capacity = list->capacity ? list->capacity * 2 : 64;
+            list->inodes = realloc(list->inodes, list->capacity * sizeof(uint32_t));
+        }
+        list->inodes[list->count++] = inodeNum;
     }
-    
-    // locations of deleted inodes
-    for (int i = 0; i < deletionCount; i++) {
-        
-        // printf("processing deletion %d\n", i); // debug
-        
-        // parent directory
-        uint32_t parentInode = delParentInode(deletions[i].inodeNum);
-        
-        if (parentInode > 0) {
-            deletions[i].parentInode = parentInode;
-            deletions[i].foundLocation = 1;
-            
-            // full path
-            char resultPath[PATH_MAX];
-            int found = 0;
-            findPath(deletions[i].inodeNum, EXT2_ROOT_INODE, "", resultPath, &found);
-            
-            if (found) {
-                
-                int i7;
-                for (i7 = 0; resultPath[i7] != '\0'; i7++) {
-                    deletions[i].path[i7] = resultPath[i7];
-                }
-                deletions[i].path[i7] = '\0'; // null terminate
-            }
+}
+
+// all inodes from firstInode up that match, in inode order
+// groups are scanned in parallel, the per group lists are joined in group order
+// slots only matters in bitmap mode, otherwise every slot is looked at
+uint32_t *collectInodes(int (*match)(uint32_t inodeNum, const struct ext2_inode *inode), uint32_t firstInode, int slots, uint32_t *count) {
+
+    struct inodeScan scan;
+    scan.match = match;
+    scan.firstInode = firstInode;
+    scan.slots = slots;
+    scan.lists = calloc(blockGroupCount, sizeof(struct inodeList));
+
+    forEachGroup(scanGroup, &scan);
+
+    uint32_t total = 0;
+    for (uint32_t group = 0; group < blockGroupCount; group++) {
+        total += scan.lists[group].count;
+    }
+
+    uint32_t *inodes = malloc((total + 1) * sizeof(uint32_t));
+    *count = 0;
+
+    for (uint32_t group = 0; group < blockGroupCount; group++) {
+        // an empty group never allocated its list
+        if (scan.lists[group].count > 0) {
+            memcpy(inodes + *count, scan.lists[group].inodes, scan.lists[group].count * sizeof(uint32_t));
         }
+        *count += scan.lists[group].count;
+        free(scan.lists[group].inodes);
     }
-    
-    // output deletion history
-    for (int i = 0; i < deletionCount; i++) {
-    
-        if (deletions[i].isDirectory) {
-            // directory (rmdir)
-            if (deletions[i].foundLocation) {
-                if (firstHistoryLine) {
-                    fprintf(historyOutputFile, "%u rmdir [%s] [%u] [%u]", deletions[i].deletionTime, deletions[i].path,  deletions[i].parentInode, deletions[i].inodeNum);
-                    firstHistoryLine = 0;  // not first line anymore
-                } else {
-                    fprintf(historyOutputFile, "\n%u rmdir [%s] [%u] [%u]", deletions[i].deletionTime, deletions[i].path,  deletions[i].parentInode, deletions[i].inodeNum);
-                }
-            } else {
-                if (firstHistoryLine) {
-                    fprintf(historyOutputFile, "%u rmdir [?] [?] [%u]", deletions[i].deletionTime, deletions[i].inodeNum);
-                    firstHistoryLine = 0; 
-                } else {
-                    fprintf(historyOutputFile, "\n%u rmdir [?] [?] [%u]", deletions[i].deletionTime, deletions[i].inodeNum);
-                }
+    free(scan.lists);
+
+    return inodes;
+}
+
+// scan filters
+int isDeletedInode(uint32_t inodeNum, const struct ext2_inode *inode) {
+    return inode->deletion_time > 0;
+}
+
+int isDeletedDirectory(uint32_t inodeNum, const struct ext2_inode *inode) {
+    return inode->deletion_time > 0 && (inode->mode & EXT2_I_DTYPE);
+}
+
+int isCreatedInode(uint32_t inodeNum, const struct ext2_inode *inode) {
+    return inode->access_time > 0;
+}
+
+
+////////////////////////////// directory index
+
+// one entry found in a directory block, live or ghost
+struct dirRecord {
+    uint32_t dirInode;    // directory holding the entry
+    uint32_t inodeNum;    // inode the entry points to
+    uint32_t nameOffset;  // null terminated name in namePool
+    uint8_t nameLength;
+    uint8_t isGhost;
+};
+
+// records of one block group's directories, filled by one thread
+struct dirIndexPart {
+    struct dirRecord *records;
+    uint32_t recordCount;
+    uint32_t recordCapacity;
+    char *names;
+    size_t namesSize;
+    size_t namesCapacity;
+};
+
+// all records, directories in inode order, entries in block order
+struct dirRecord *dirRecords;
+uint32_t dirRecordCount;
+
+char *namePool;
+size_t namePoolSize;
+
+// lookups by inode number, record index + 1, 0 means none
+uint32_t *firstGhostOf;   // first ghost entry naming this inode
+uint32_t *firstLiveOf;    // first live entry naming this inode
+
+// records of a directory are back to back
+uint32_t *firstRecordOfDir;
+uint32_t *recordCountOfDir;
+
+// check name is . or ..
+int isDotName(const struct ext2_dir_entry *entry) {
+    return entry->name[0] == '.' && (entry->name_length == 1 || (entry->name_length == 2 && entry->name[1] == '.'));
+}
+
+// append entry to a part of the index
+void addDirRecord(struct dirIndexPart *part, uint32_t dirInode, const struct ext2_dir_entry *entry, int isGhost) {
+
+    if (part->recordCount == part->recordCapacity) {
+        part->recordCapacity = part->recordCapacity ? part->recordCapacity * 2 : 256;
+        part->records = realloc(part->records, part->recordCapacity * sizeof(struct dirRecord));
+    }
+    if (part->namesSize + entry->name_length + 1 > part->namesCapacity) {
+        part->namesCapacity = part->namesCapacity ? part->namesCapacity * 2 : 4096;
+        part->names = realloc(part->names, part->namesCapacity);
+    }
+
+    struct dirRecord *record = &part->records[part->recordCount];
+    record->dirInode = dirInode;
+    record->inodeNum = entry->inode;
+    record->nameOffset = part->namesSize;
+    record->nameLength = entry->name_length;
+    record->isGhost = isGhost;
+
+    copyEntryName(entry, part->names + part->namesSize);
+    part->namesSize += entry->name_length + 1;
+
+    part->recordCount++;
+}
+
+// name of a record
+const char *recordName(const struct dirRecord *record) {
+    return namePool + record->nameOffset;
+}
+
+// parse one directory block, ghosts in the slack of an entry come before the entry itself
+void indexDirectoryBlock(struct dirIndexPart *part, uint32_t dirInode, const char *data) {
+
+    uint32_t position = 0;
+
+    while (position < blockSize) {
+        const struct ext2_dir_entry *entry = (const struct ext2_dir_entry *)(data + position);
+
+        if (entry->length == 0 || entry->length < EXT2_DIR_ENTRY_HEADER_SIZE) {
+            break;
+        }
+
+        // length is larger than expected, might be ghost entries after the name
+        uint32_t expectedLength = EXT2_DIR_LENGTH(entry->name_length);
+
+        if (expectedLength <= entry->length && entry->length > expectedLength + EXT2_DIR_ENTRY_HEADER_SIZE) {
+
+            uint32_t ghostPos = position + expectedLength;
+
+            // align to 4 bytes
+            while (ghostPos % 4 != 0) {
+                ghostPos++;
             }
-        } else {
-            // file (rm)
-            if (deletions[i].foundLocation) {
-                if (firstHistoryLine) {
-                    fprintf(historyOutputFile, "%u rm [%s] [%u] [%u]", deletions[i].deletionTime, deletions[i].path, deletions[i].parentInode, deletions[i].inodeNum);
-                    firstHistoryLine = 0;
-                } else {
-                    fprintf(historyOutputFile, "\n%u rm [%s] [%u] [%u]", deletions[i].deletionTime, deletions[i].path, deletions[i].parentInode, deletions[i].inodeNum);
+
+            while (ghostPos + EXT2_DIR_ENTRY_HEADER_SIZE <= position + entry->length && ghostPos < blockSize) {
+                const struct ext2_dir_entry *ghostEntry = (const struct ext2_dir_entry *)(data + ghostPos);
+
+                if (ghostEntry->inode > 0 && ghostEntry->inode <= mySuperblock->inode_count && ghostEntry->name_length > 0) {
+
+                    if (!isDotName(ghostEntry)) {
+                        addDirRecord(part, dirInode, ghostEntry, 1);
+                    }
+
+                    // valid ghost, its length leads to the next one
+                    ghostPos += ghostEntry->length >= 4 ? ghostEntry->length : 4;
                 }
-            } else {
-                if (firstHistoryLine) {
-                    fprintf(historyOutputFile, "%u rm [?] [?] [%u]", deletions[i].deletionTime, deletions[i].inodeNum);
-                    firstHistoryLine = 0;
-                } else {
-                    fprintf(historyOutputFile, "\n%u rm [?] [?] [%u]", deletions[i].deletionTime, deletions[i].inodeNum);
+                else {
+                    // next 4 byte position for other ghost entry
+                    ghostPos += 4;
                 }
             }
         }
+
+        // regular entries, skip . and ..
+        if (entry->inode != 0 && !isDotName(entry)) {
+            addDirRecord(part, dirInode, entry, 0);
+        }
+
+        position += entry->length;
     }
 }
 
-// created files and directories
-void funcCreated() {
-    
-    // 1000??? check later
-    struct mkdirTouch creations[PATH_MAX];
-    int creationCount = 0;
-    
-    // cchecking creation times
-    // starting from inode 11
-    for (uint32_t inodeNum = 11; inodeNum <= mySuperblock.inode_count; inodeNum++) {
-        // calculate inode location
-        uint32_t inodeLoc = inodeLocationCalculation(inodeNum);
-        
-        // read inode
-        struct ext2_inode tempInode;
-        pread(fd, &tempInode, sizeof(tempInode), inodeLoc);
-        
+// index every directory of one block group
+void indexGroup(uint32_t group, void *context) {
 
-        if (tempInode.access_time > 0 && creationCount < PATH_MAX) {
-            
-            // process all inodes starting from 11
-            if (creationCount < PATH_MAX) {
-                
-                // store creation info
-                creations[creationCount].inodeNum = inodeNum;
-                creations[creationCount].creationTime = tempInode.access_time;
-                
-                // check if directory or file
-                // from ext2fs.h
-                if (tempInode.mode & EXT2_I_DTYPE) {
-                    creations[creationCount].isDirectory = 1;
-                } else {
-                    creations[creationCount].isDirectory = 0;
-                }
-                
-                creations[creationCount].foundLocation = 0;
-                creations[creationCount].parentInode = 0;
-                
-                creations[creationCount].path[0] = '?';
-                creations[creationCount].path[1] = '\0';
-                
-                creationCount++;
+    struct dirIndexPart *part = &((struct dirIndexPart *)context)[group];
+
+    // live directories and deleted ones
+    struct slotCursor cursor;
+    startSlotCursor(&cursor, group, SCAN_ALLOCATED | SCAN_FREE);
+
+    uint32_t inodeNum;
+    while ((inodeNum = nextSlot(&cursor)) != 0) {
+        if (!isDirectory(inodeNum)) {
+            continue;
+        }
+
+        // blocks of a deleted directory that were handed out again hold something else now
+        int deletedDir = !isInodeAllocated(inodeNum);
+
+        struct blockIterator blocks;
+        startBlockIterator(&blocks, getInode(inodeNum));
+
+        uint32_t blockNum;
+        while ((blockNum = nextBlock(&blocks)) != 0) {
+
+            if (deletedDir && isBlockInUse(blockNum)) {
+                continue;
+            }
+
+            char *data = getBlock(blockNum);
+            if (data == NULL) {
+                continue;
             }
+
+            indexDirectoryBlock(part, inodeNum, data);
         }
+        endBlockIterator(&blocks);
     }
-    
-    // paths created inodes
-    for (int i = 0; i < creationCount; i++) {
-        
-        //  path from root
-        char resultPath[PATH_MAX];
-        int found = 0;
-        findPath(creations[i].inodeNum, EXT2_ROOT_INODE, "", resultPath, &found);
-        
-        if (found) {
-            int kk;
-            for (kk = 0; resultPath[kk] != '\0'; kk++) {
-                creations[i].path[kk] = resultPath[kk];
+}
+
+// one pass over every directory block of every directory inode
+// groups are parsed in parallel and glued together in group order, so the result
+// does not depend on the thread count
+void buildDirIndex() {
+
+    uint32_t inodeCount = mySuperblock->inode_count;
+    struct dirIndexPart *parts = calloc(blockGroupCount, sizeof(struct dirIndexPart));
+
+    forEachGroup(indexGroup, parts);
+
+    size_t totalNames = 0;
+    for (uint32_t group = 0; group < blockGroupCount; group++) {
+        dirRecordCount += parts[group].recordCount;
+        totalNames += parts[group].namesSize;
+    }
+
+    dirRecords = malloc((dirRecordCount + 1) * sizeof(struct dirRecord));
+    namePool = malloc(totalNames + 1);
+
+    uint32_t recordBase = 0;
+    for (uint32_t group = 0; group < blockGroupCount; group++) {
+        struct dirIndexPart *part = &parts[group];
+
+        for (uint32_t ii = 0; ii < part->recordCount; ii++) {
+            dirRecords[recordBase + ii] = part->records[ii];
+            dirRecords[recordBase + ii].nameOffset += namePoolSize;
+        }
+        if (part->namesSize > 0) {
+            memcpy(namePool + namePoolSize, part->names, part->namesSize);
+        }
+
+        recordBase += part->recordCount;
+        namePoolSize += part->namesSize;
+
+        free(part->records);
+        free(part->names);
+    }
+    free(parts);
+
+    firstGhostOf = calloc(inodeCount + 1, sizeof(uint32_t));
+    firstLiveOf = calloc(inodeCount + 1, sizeof(uint32_t));
+    firstRecordOfDir = calloc(inodeCount + 1, sizeof(uint32_t));
+    recordCountOfDir = calloc(inodeCount + 1, sizeof(uint32_t));
+
+    for (uint32_t ii = 0; ii < dirRecordCount; ii++) {
+        struct dirRecord *record = &dirRecords[ii];
+
+        if (recordCountOfDir[record->dirInode]++ == 0) {
+            firstRecordOfDir[record->dirInode] = ii;
+        }
+
+        // first occurrence wins, same as scanning directories in inode order
+        uint32_t *first = record->isGhost ? firstGhostOf : firstLiveOf;
+        if (record->inodeNum <= inodeCount && first[record->inodeNum] == 0) {
+            first[record->inodeNum] = ii + 1;
+        }
+    }
+}
+
+void freeDirIndex() {
+    free(dirRecords);
+    free(namePool);
+    free(firstGhostOf);
+    free(firstLiveOf);
+    free(firstRecordOfDir);
+    free(recordCountOfDir);
+}
+
+
+
+
+////////////////////////////// path resolver
+
+// parent pointers in the order a depth first search from root meets entries
+uint32_t *pathParentOf;   // directory of the first entry met, 0 if never met
+uint32_t *pathRecordOf;   // that entry, record index + 1
+char **pathOf;            // resolved full paths, filled on demand
+
+// deleted directories hanging under a directory, in inode order
+uint32_t *deletedChildHead;
+uint32_t *deletedChildNext;
+
+// stack frame for the search
+struct searchFrame {
+    uint32_t dirInode;
+    uint32_t nextRecord;        // next record of dirInode to look at
+    uint32_t nextDeletedChild;  // next deleted directory to descend into
+};
+
+// walk the tree from root once and give every reachable inode a parent
+// order is the old recursive findPath order: entries of a directory in block order,
+// descending into live subdirectories on the way, then its deleted subdirectories
+void buildParentTable() {
+
+    uint32_t inodeCount = mySuperblock->inode_count;
+
+    pathParentOf = calloc(inodeCount + 1, sizeof(uint32_t));
+    pathRecordOf = calloc(inodeCount + 1, sizeof(uint32_t));
+    pathOf = calloc(inodeCount + 1, sizeof(char *));
+    deletedChildHead = calloc(inodeCount + 1, sizeof(uint32_t));
+    deletedChildNext = calloc(inodeCount + 1, sizeof(uint32_t));
+
+    // deleted directories under the directory holding their first ghost entry
+    // going backwards and pushing to the front keeps inode order
+    uint32_t deletedDirCount;
+    uint32_t *deletedDirs = collectInodes(isDeletedDirectory, 1, SCAN_FREE, &deletedDirCount);
+
+    for (uint32_t ii = deletedDirCount; ii > 0; ii--) {
+        uint32_t inodeNum = deletedDirs[ii - 1];
+        uint32_t parent = delParentInode(inodeNum);
+        if (parent != 0 && parent != inodeNum) {
+            deletedChildNext[inodeNum] = deletedChildHead[parent];
+            deletedChildHead[parent] = inodeNum;
+        }
+    }
+    free(deletedDirs);
+
+    char *visited = calloc(inodeCount + 1, 1);
+    struct searchFrame *stack = malloc((inodeCount + 1) * sizeof(struct searchFrame));
+    uint32_t depth = 0;
+
+    stack[depth].dirInode = EXT2_ROOT_INODE;
+    stack[depth].nextRecord = firstRecordOfDir[EXT2_ROOT_INODE];
+    stack[depth].nextDeletedChild = deletedChildHead[EXT2_ROOT_INODE];
+    visited[EXT2_ROOT_INODE] = 1;
+    depth++;
+
+    while (depth > 0) {
+        struct searchFrame *frame = &stack[depth - 1];
+        uint32_t dirInode = frame->dirInode;
+        uint32_t child = 0;
+
+        if (frame->nextRecord < firstRecordOfDir[dirInode] + recordCountOfDir[dirInode]) {
+
+            uint32_t recordIndex = frame->nextRecord++;
+            struct dirRecord *record = &dirRecords[recordIndex];
+
+            // live entries are indexed as they are on disk, a corrupted one can point past the inode table
+            if (record->inodeNum == 0 || record->inodeNum > inodeCount) {
+                continue;
             }
-            creations[i].path[kk] = '\0';
-            creations[i].foundLocation = 1;
-            
 
-            // parent path 
-            char *lastSlash = NULL;
+            if (record->inodeNum != EXT2_ROOT_INODE && pathParentOf[record->inodeNum] == 0) {
+                pathParentOf[record->inodeNum] = dirInode;
+                pathRecordOf[record->inodeNum] = recordIndex + 1;
+            }
 
-            for (int j = 0; resultPath[j] != '\0'; j++) {
-                if (resultPath[j] == '/') {
-                    lastSlash = &resultPath[j];
-                }
+            // only live subdirectories are entered here
+            if (!record->isGhost && isDirectory(record->inodeNum)) {
+                child = record->inodeNum;
             }
-            
-            if (lastSlash && lastSlash != resultPath) {
-                // parent path 
-                char parentPath[PATH_MAX];
-                int parentLen = lastSlash - resultPath;
+        }
+        else if (frame->nextDeletedChild != 0) {
+            child = frame->nextDeletedChild;
+            frame->nextDeletedChild = deletedChildNext[child];
+        }
+        else {
+            // directory done
+            depth--;
+            continue;
+        }
 
-                for (int k = 0; k < parentLen; k++) {
-                    parentPath[k] = resultPath[k];
-                }
-                parentPath[parentLen] = '\0';
-                
-                // find parent inode by searching for exact path match
-                for (uint32_t checkInode = 1; checkInode <= mySuperblock.inode_count; checkInode++) {
-                    
-                    if (isDirectory(checkInode)) {
+        if (child != 0 && !visited[child]) {
+            visited[child] = 1;
+            stack[depth].dirInode = child;
+            stack[depth].nextRecord = firstRecordOfDir[child];
+            stack[depth].nextDeletedChild = deletedChildHead[child];
+            depth++;
+        }
+    }
 
-                        char checkPath[PATH_MAX];
-                        int checkFound = 0;
+    free(stack);
+    free(visited);
+}
 
-                        findPath(checkInode, EXT2_ROOT_INODE, "", checkPath, &checkFound);
-                        
-                        if (checkFound) {
-                            
-                            // compare paths
-                            if (strcmp(parentPath, checkPath) == 0) {
-                                creations[i].parentInode = checkInode;
-                                break;
-                            }
-                        }
-                    }
-                }
-            } 
-            else {
-                // no parent path found, direct child of root
-                creations[i].parentInode = EXT2_ROOT_INODE;
-            }
+// full path of an inode, NULL if it is not reachable from root
+// walks parent pointers up to the closest resolved directory, then builds the prefixes down
+const char *inodePath(uint32_t inodeNum) {
+
+    if (inodeNum == 0 || inodeNum > mySuperblock->inode_count || pathParentOf[inodeNum] == 0) {
+        return NULL;
+    }
+    if (pathOf[inodeNum] != NULL) {
+        return pathOf[inodeNum];
+    }
+
+    // chain of unresolved inodes, target first
+    uint32_t chainCapacity = 64;
+    uint32_t *chain = malloc(chainCapacity * sizeof(uint32_t));
+    uint32_t chainLength = 0;
+
+    uint32_t current = inodeNum;
+    while (current != EXT2_ROOT_INODE && pathOf[current] == NULL) {
+        if (chainLength == chainCapacity) {
+            chainCapacity *= 2;
+            chain = realloc(chain, chainCapacity * sizeof(uint32_t));
         }
+        chain[chainLength++] = current;
+        current = pathParentOf[current];
+    }
+
+    // root has an empty prefix, every path starts with /
+    const char *prefix = current == EXT2_ROOT_INODE ? "" : pathOf[current];
+
+    while (chainLength > 0) {
+        uint32_t node = chain[--chainLength];
+        const char *name = recordName(&dirRecords[pathRecordOf[node] - 1]);
+
+        size_t length = strlen(prefix) + 1 + strlen(name) + 1;
+        pathOf[node] = malloc(length);
+        snprintf(pathOf[node], length, "%s/%s", prefix, name);
+
+        prefix = pathOf[node];
+    }
+
+    free(chain);
+    return pathOf[inodeNum];
+}
+
+void freeParentTable() {
+    for (uint32_t inodeNum = 0; inodeNum <= mySuperblock->inode_count; inodeNum++) {
+        free(pathOf[inodeNum]);
     }
+    free(pathOf);
+    free(pathParentOf);
+    free(pathRecordOf);
+    free(deletedChildHead);
+    free(deletedChildNext);
+}
+
+
+
+
+////////////////////////////// history part
+
+// find parent directory inode for deleted entry
+// directory holding the first ghost entry for it, from the index
+uint32_t delParentInode(uint32_t targetInode) {
+
+    if (targetInode == 0 || targetInode > mySuperblock->inode_count || firstGhostOf[targetInode] == 0) {
+        return 0; // not found
+    }
+
+    return dirRecords[firstGhostOf[targetInode] - 1].dirInode;
+}
+
+// find deleted files and their locations
+void deletedFiles() {
     
-    // output creation history
-    for (int i = 0; i < creationCount; i++) {
-        
-        if (creations[i].foundLocation) {
+    // find all deleted inodes, groups scanned in parallel
+    uint32_t deletedCount;
+    uint32_t *deletedInodes = collectInodes(isDeletedInode, 1, SCAN_FREE, &deletedCount);
 
-            if (creations[i].isDirectory) {
-                
-                if (firstHistoryLine) {
-                    fprintf(historyOutputFile, "%u mkdir [%s] [%u] [%u]", creations[i].creationTime, creations[i].path,creations[i].parentInode, creations[i].inodeNum);
-                    firstHistoryLine = 0;  // not first line anymore
-                } 
-                else {
-                    fprintf(historyOutputFile, "\n%u mkdir [%s] [%u] [%u]", creations[i].creationTime, creations[i].path,creations[i].parentInode, creations[i].inodeNum);
-                }
-            } 
-            else {
-                if (firstHistoryLine) {
-                    fprintf(historyOutputFile, "%u touch [%s] [%u] [%u]", creations[i].creationTime, creations[i].path, creations[i].parentInode, creations[i].inodeNum);
-                    firstHistoryLine = 0; 
-                } 
-                else {
-                    fprintf(historyOutputFile, "\n%u touch [%s] [%u] [%u]", creations[i].creationTime, creations[i].path, creations[i].parentInode, creations[i].inodeNum);
-                }
+    for (uint32_t ii = 0; ii < deletedCount; ii++) {
+        uint32_t inodeNum = deletedInodes[ii];
+        struct ext2_inode *tempInode = getInode(inodeNum);
+
+        // directory (rmdir) or file (rm)
+        enum historyAction action = (tempInode->mode & EXT2_I_DTYPE) ? HISTORY_RMDIR : HISTORY_RM;
+        
+        // parent directory, unknown location prints [?] [?]
+        uint32_t parentInode = delParentInode(inodeNum);
+        const char *path = NULL;
+        
+        if (parentInode > 0) {
+            // full path, parent known but path not is [?] [parent]
+            path = inodePath(inodeNum);
+            if (path == NULL) {
+                path = "?";
             }
         }
+
+        historyAdd(&history, tempInode->deletion_time, action, path, parentInode, inodeNum);
     }
+    free(deletedInodes);
+}
+
+// created files and directories
+void funcCreated() {
+    
+    // cchecking creation times
+    // starting from inode 11, groups scanned in parallel
+    uint32_t createdCount;
+    uint32_t *createdInodes = collectInodes(isCreatedInode, 11, SCAN_ALLOCATED | SCAN_FREE, &createdCount);
+
+    for (uint32_t ii = 0; ii < createdCount; ii++) {
+        uint32_t inodeNum = createdInodes[ii];
+        struct ext2_inode *tempInode = getInode(inodeNum);
+        
+        //  path from root, only located inodes are reported
+        const char *path = inodePath(inodeNum);
+        if (path == NULL) {
+            continue;
+        }
+
+        // check if directory or file
+        enum historyAction action = (tempInode->mode & EXT2_I_DTYPE) ? HISTORY_MKDIR : HISTORY_TOUCH;
+
+        // parent is the directory the path was found in
+        historyAdd(&history, tempInode->access_time, action, path, pathParentOf[inodeNum], inodeNum);
+    }
+    free(createdInodes);
 }
 
 // move action
@@ -904,56 +1205,163 @@ void findMv() {
 //////////////////////////////////////////////////////////// end history
 ///////////////////////
 
+////////////////////////////// run statistics
+
+// --stats: phase times, syscalls and peak memory on stderr
+int statsMode = 0;
+struct timespec phaseStart;
+
+void startPhase() {
+    if (statsMode) {
+        clock_gettime(CLOCK_MONOTONIC, &phaseStart);
+    }
+}
+
+void endPhase(const char *phase) {
+    if (!statsMode) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (now.tv_sec - phaseStart.tv_sec) + (now.tv_nsec - phaseStart.tv_nsec) / 1e9;
+    fprintf(stderr, "phase %s %.6f\n", phase, seconds);
+}
+
+void reportStats() {
+    if (!statsMode) {
+        return;
+    }
+
+    // read and write syscall counts of this process
+    FILE *io = fopen("/proc/self/io", "r");
+    if (io != NULL) {
+        char key[64];
+        unsigned long long value;
+        while (fscanf(io, "%63[^:]: %llu\n", key, &value) == 2) {
+            if (strcmp(key, "syscr") == 0 || strcmp(key, "syscw") == 0) {
+                fprintf(stderr, "%s %llu\n", key, value);
+            }
+        }
+        fclose(io);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "maxrss_kb %ld\n", usage.ru_maxrss);
+}
+
 
 int main(int argc, char *argv[]) {
 
-    char *image = argv[1];              
-    char *stateOutput = argv[2];       
-    char *historyOutput = argv[3];     
+    // positional: image, state output, history output
+    // options: --threads N, --bitmap, --stats
+    char *positional[3];
+    int positionalCount = 0;
+
+    for (int ii = 1; ii < argc; ii++) {
+        if (strcmp(argv[ii], "--bitmap") == 0) {
+            bitmapMode = 1;
+        }
+        else if (strcmp(argv[ii], "--stats") == 0) {
+            statsMode = 1;
+        }
+        else if (strcmp(argv[ii], "--threads") == 0 && ii + 1 < argc) {
+            threadCount = atoi(argv[++ii]);
+            if (threadCount < 1) {
+                threadCount = 1;
+            }
+        }
+        else if (positionalCount < 3) {
+            positional[positionalCount++] = argv[ii];
+        }
+    }
+
+    if (positionalCount < 3) {
+        fprintf(stderr, "usage: %s [--threads N] [--bitmap] [--stats] image state_output history_output\n", argv[0]);
+        return 1;
+    }
 
-    // open filesystem image
-    fd = open(image, O_RDONLY); 
+    char *image = positional[0];              
+    char *statePath = positional[1];       
+    char *historyPath = positional[2];     
+
+    // map filesystem image
+    startPhase();
+    if (mapImage(image) < 0) {
+        return 1;
+    }
 
-    // read superblock
-    pread(fd, &mySuperblock, sizeof(mySuperblock), EXT2_SUPER_BLOCK_POSITION);
+    // superblock
+    mySuperblock = (const struct ext2_super_block *)(imageData + EXT2_SUPER_BLOCK_POSITION);
 
     // blockSize = 2^(10 + logBlockSize)
-    blockSize = EXT2_UNLOG(mySuperblock.log_block_size);
+    blockSize = EXT2_UNLOG(mySuperblock->log_block_size);
 
-    uint32_t blockGroupCount = (mySuperblock.block_count + mySuperblock.blocks_per_group - 1) / mySuperblock.blocks_per_group;
+    blockGroupCount = (mySuperblock->block_count + mySuperblock->blocks_per_group - 1) / mySuperblock->blocks_per_group;
 
     // block group descriptors
-    uint32_t bgdBlock = mySuperblock.first_data_block + 1;
-    uint32_t bgdOffset = bgdBlock * blockSize;
+    uint32_t bgdBlock = mySuperblock->first_data_block + 1;
+    size_t bgdOffset = (size_t)bgdBlock * blockSize;
 
-    bgdTable = malloc(blockGroupCount * sizeof(struct ext2_block_group_descriptor));
-    pread(fd, bgdTable, blockGroupCount * sizeof(struct ext2_block_group_descriptor), bgdOffset);
+    if (bgdOffset + blockGroupCount * sizeof(struct ext2_block_group_descriptor) > imageSize) {
+        fprintf(stderr, "%s: block group descriptors outside image\n", image);
+        unmapImage();
+        return 1;
+    }
+    bgdTable = (const struct ext2_block_group_descriptor *)(imageData + bgdOffset);
+
+    // inode tables inside the mapping
+    loadInodeTables();
+    if (bitmapMode) {
+        loadBitmaps();
+    }
+    endPhase("load");
 
     // open file
-    stateOutputFile = fopen(stateOutput, "w");
-    
-    // new line flag
-    firstStateLine = 1;
+    startPhase();
+    if (outOpen(&stateOutput, statePath, &textFormat, 1) < 0) {
+        return 1;
+    }
     
-    fprintf(stateOutputFile, "- %u:root/", EXT2_ROOT_INODE);
-    firstStateLine = 0; 
+    writeStateEntry(&stateOutput, 1, EXT2_ROOT_INODE, "root", 1, 0);
     
     displayHierarchy(EXT2_ROOT_INODE, 2);
-    fprintf(stateOutputFile, "\n"); 
-    fclose(stateOutputFile);
+    outClose(&stateOutput);
+    endPhase("hierarchy");
 
-    historyOutputFile = fopen(historyOutput, "w");
-    
+    if (outOpen(&historyOutput, historyPath, &textFormat, 0) < 0) {
+        return 1;
+    }
+
+    // parent and name of every entry, live and ghost
+    startPhase();
+    buildDirIndex();
+    buildParentTable();
+    endPhase("index");
     
-    firstHistoryLine = 1;
+    // detectors feed one log, it comes out as a single timeline
+    historyInit(&history);
+    startPhase();
     funcCreated();
+    endPhase("creations");
     //findMv(); // 
+    startPhase();
     deletedFiles();
+    endPhase("deletions");
+    startPhase();
+    historyFinish(&history, &historyOutput);
 
-    fclose(historyOutputFile);
+    outClose(&historyOutput);
+    endPhase("timeline");
 
-    free(bgdTable);
-    close(fd);
+    freeParentTable();
+    freeDirIndex();
+    if (bitmapMode) {
+        freeBitmaps();
+    }
+    free(inodeTables);
+    unmapImage();
 
+    reportStats();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,681 @@
+// synthetic ext2 image generator for benchmarking histext2fs
+//
+// builds a directory tree breadth first from root, every directory gets
+// --fanout entries, a quarter of them subdirectories until --depth is reached,
+// until --inodes entries exist. files are deleted with --delete-rate, and
+// --ghost-density of the deleted entries stay readable in the slack of the
+// entry before them, like a real ext2 unlink leaves them. --rmdir-rate of the
+// directories are removed with everything under them, children first, and
+// their blocks are freed but keep their contents. --corrupt-rate of
+// the live entries point past the inode table, like a damaged image.
+//
+// layout has no sparse_super: every group starts with a superblock copy,
+// the descriptor table, block bitmap, inode bitmap and inode table
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ext2fs.h"
+
+#define BASE_TIME 1600000000u
+#define CORRUPT_INODE 0xFFFFFF00u   // inode number written into corrupted entries
+
+// generator settings
+struct genConfig {
+    uint32_t entryCount;      // files and directories besides root and lost+found
+    uint32_t depth;
+    uint32_t fanout;
+    double deleteRate;
+    double rmdirRate;
+    double ghostDensity;
+    double corruptRate;
+    uint32_t blockSize;
+    uint32_t inodesPerGroup;
+    uint64_t seed;
+};
+
+// one file or directory of the tree
+struct genEntry {
+    uint32_t inodeNum;
+    uint32_t parent;        // entry index of the parent directory
+    uint32_t level;
+    int isDirectory;
+    int deleted;
+    int ghost;              // deleted entry still readable in the directory block
+    int corrupt;            // live entry written with CORRUPT_INODE
+    uint32_t createTime;
+    uint32_t deleteTime;
+    uint32_t firstChild;    // children are back to back in the entry array
+    uint32_t childCount;
+    uint32_t subdirCount;
+
+    // directory contents, filled when blocks are laid out
+    char *blocks;
+    uint32_t blockCount;
+    uint32_t blockNums[EXT2_NUM_DIRECT_BLOCKS + 2];   // direct, single, double
+};
+
+struct genEntry *entries;
+uint32_t entryTotal;
+
+uint64_t randomState;
+
+// xorshift, reproducible for a given seed
+uint64_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+double randomUnit() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void entryName(const struct genEntry *entry, char *name) {
+    if (entry->inodeNum == 11) {
+        strcpy(name, "lost+found");
+    }
+    else {
+        sprintf(name, "%c%u", entry->isDirectory ? 'd' : 'f', entry->inodeNum);
+    }
+}
+
+// root, lost+found, then the tree breadth first
+void buildTree(const struct genConfig *config) {
+
+    uint32_t capacity = config->entryCount + 2;
+    entries = calloc(capacity, sizeof(struct genEntry));
+
+    // root is entry 0, inode 2
+    entries[0].inodeNum = EXT2_ROOT_INODE;
+    entries[0].isDirectory = 1;
+    entries[0].createTime = BASE_TIME;
+
+    // lost+found is entry 1, inode 11
+    entries[1].inodeNum = 11;
+    entries[1].isDirectory = 1;
+    entries[1].createTime = BASE_TIME;
+    entryTotal = 2;
+
+    uint32_t nextInode = 12;
+    uint32_t subdirsPerDir = (config->fanout + 3) / 4;
+
+    // every directory entry is a queue slot, children are appended in order
+    for (uint32_t current = 0; current < entryTotal && entryTotal < capacity; current++) {
+        struct genEntry *dir = &entries[current];
+        if (!dir->isDirectory || current == 1) {
+            continue;
+        }
+
+        dir->firstChild = entryTotal;
+        if (current == 0) {
+            // lost+found is the first child of root
+            dir->firstChild = 1;
+            dir->childCount = 1;
+            dir->subdirCount = 1;
+        }
+
+        for (uint32_t ii = 0; ii < config->fanout && entryTotal < capacity; ii++) {
+            struct genEntry *child = &entries[entryTotal];
+
+            child->inodeNum = nextInode++;
+            child->parent = current;
+            child->level = dir->level + 1;
+            child->isDirectory = ii < subdirsPerDir && child->level < config->depth;
+            child->createTime = BASE_TIME + 7 * child->inodeNum;
+
+            // files one by one, directories only with --rmdir-rate and then with their contents
+            if (!child->isDirectory && randomUnit() < config->deleteRate) {
+                child->deleted = 1;
+                child->ghost = randomUnit() < config->ghostDensity;
+                child->deleteTime = BASE_TIME + 7 * (config->entryCount + 12) + (uint32_t)(nextRandom() % 100000);
+            }
+
+            // no draw at rate 0, images of a seed stay the same
+            if (child->isDirectory && config->rmdirRate > 0 && randomUnit() < config->rmdirRate) {
+                // after every single file deletion, room below for the levels under it
+                child->deleted = 1;
+                child->ghost = randomUnit() < config->ghostDensity;
+                child->deleteTime = BASE_TIME + 7 * (config->entryCount + 12) + 100000 + 16 * config->depth + (uint32_t)(nextRandom() % 100000);
+            }
+
+            // removed directory was emptied first, whatever is left in it goes just before it
+            if (dir->deleted && (!child->deleted || child->deleteTime >= dir->deleteTime)) {
+                child->deleted = 1;
+                child->ghost = randomUnit() < config->ghostDensity;
+                child->deleteTime = dir->deleteTime - 1 - (uint32_t)(nextRandom() % 15);
+            }
+
+            // no draw at rate 0, images of a seed stay the same
+            if (!child->deleted && config->corruptRate > 0 && randomUnit() < config->corruptRate) {
+                child->corrupt = 1;
+            }
+
+            dir = &entries[current];
+            dir->childCount++;
+            dir->subdirCount += child->isDirectory && !child->deleted;
+            entryTotal++;
+        }
+    }
+}
+
+// append one directory entry to a directory being packed
+struct dirPacker {
+    char *data;
+    uint32_t capacityBlocks;
+    uint32_t used;          // bytes used in the whole buffer
+    uint32_t lastEntry;     // offset of the previous entry, its rec_len absorbs slack
+    uint32_t lastLive;      // offset of the previous live entry in the same block
+    int blockHasEntry;
+    uint32_t blockSize;
+};
+
+void packEntry(struct dirPacker *packer, uint32_t inodeNum, const char *name, int fileType, int deleted, int ghost) {
+
+    uint32_t nameLength = strlen(name);
+    uint32_t length = (EXT2_DIR_ENTRY_HEADER_SIZE + nameLength + 3) & ~3u;
+    uint32_t blockEnd = (packer->used / packer->blockSize + 1) * packer->blockSize;
+
+    // previous entry ended exactly on the block boundary
+    if (packer->used % packer->blockSize == 0) {
+        packer->blockHasEntry = 0;
+    }
+
+    // does not fit, previous entry takes the rest of the block
+    if (packer->blockHasEntry && packer->used + length > blockEnd) {
+        struct ext2_dir_entry *last = (struct ext2_dir_entry *)(packer->data + packer->lastEntry);
+        last->length += blockEnd - packer->used;
+        packer->used = blockEnd;
+        packer->blockHasEntry = 0;
+    }
+
+    if (packer->used + packer->blockSize > packer->capacityBlocks * packer->blockSize) {
+        packer->capacityBlocks *= 2;
+        packer->data = realloc(packer->data, packer->capacityBlocks * packer->blockSize);
+        memset(packer->data + packer->used, 0, packer->capacityBlocks * packer->blockSize - packer->used);
+    }
+
+    struct ext2_dir_entry *entry = (struct ext2_dir_entry *)(packer->data + packer->used);
+    entry->inode = inodeNum;
+    entry->length = length;
+    entry->name_length = nameLength;
+    entry->file_type = fileType;
+    memcpy(entry->name, name, nameLength);
+
+    if (deleted) {
+        if (!packer->blockHasEntry) {
+            // first entry of a block is cleared instead of merged
+            entry->inode = 0;
+            packer->lastLive = packer->used;
+        }
+        else {
+            // unlink: the live entry before it swallows it
+            struct ext2_dir_entry *live = (struct ext2_dir_entry *)(packer->data + packer->lastLive);
+            live->length += length;
+            if (!ghost) {
+                entry->inode = 0;
+            }
+        }
+    }
+    else {
+        packer->lastLive = packer->used;
+    }
+
+    // a deleted entry in the slack keeps its own rec_len, the live one covers it
+    if (!deleted || !packer->blockHasEntry) {
+        packer->lastEntry = packer->used;
+    }
+    else {
+        packer->lastEntry = packer->lastLive;
+    }
+
+    packer->used += length;
+    packer->blockHasEntry = 1;
+}
+
+// directory blocks of every directory, in memory
+void packDirectories(uint32_t blockSize) {
+
+    for (uint32_t ii = 0; ii < entryTotal; ii++) {
+        struct genEntry *dir = &entries[ii];
+        if (!dir->isDirectory) {
+            continue;
+        }
+
+        struct dirPacker packer;
+        memset(&packer, 0, sizeof(packer));
+        packer.blockSize = blockSize;
+        packer.capacityBlocks = 1;
+        packer.data = calloc(1, blockSize);
+
+        uint32_t parentInode = ii == 0 || ii == 1 ? EXT2_ROOT_INODE : entries[dir->parent].inodeNum;
+        packEntry(&packer, dir->inodeNum, ".", EXT2_D_DTYPE, 0, 0);
+        packEntry(&packer, parentInode, "..", EXT2_D_DTYPE, 0, 0);
+
+        for (uint32_t jj = 0; jj < dir->childCount; jj++) {
+            struct genEntry *child = &entries[dir->firstChild + jj];
+            char name[32];
+
+            entryName(child, name);
+            packEntry(&packer, child->corrupt ? CORRUPT_INODE : child->inodeNum, name, child->isDirectory ? EXT2_D_DTYPE : EXT2_D_FTYPE, child->deleted, child->ghost);
+        }
+
+        // last entry takes the rest of its block
+        uint32_t blockEnd = (packer.used + blockSize - 1) / blockSize * blockSize;
+        struct ext2_dir_entry *last = (struct ext2_dir_entry *)(packer.data + packer.lastEntry);
+        last->length += blockEnd - packer.used;
+
+        dir->blocks = packer.data;
+        dir->blockCount = blockEnd / blockSize;
+    }
+}
+
+// blocks an inode needs for its block map besides data
+uint32_t indirectBlocksFor(uint32_t dataBlocks, uint32_t pointersPerBlock) {
+
+    if (dataBlocks <= EXT2_NUM_DIRECT_BLOCKS) {
+        return 0;
+    }
+    dataBlocks -= EXT2_NUM_DIRECT_BLOCKS;
+    if (dataBlocks <= pointersPerBlock) {
+        return 1;
+    }
+    dataBlocks -= pointersPerBlock;
+    if (dataBlocks > pointersPerBlock * pointersPerBlock) {
+        fprintf(stderr, "directory too large, triple indirect blocks are not generated\n");
+        exit(1);
+    }
+    return 2 + (dataBlocks + pointersPerBlock - 1) / pointersPerBlock;
+}
+
+// filesystem geometry
+struct genLayout {
+    uint32_t blockSize;
+    uint32_t firstDataBlock;
+    uint32_t blocksPerGroup;
+    uint32_t inodesPerGroup;
+    uint32_t groupCount;
+    uint32_t gdtBlocks;
+    uint32_t inodeTableBlocks;
+    uint32_t metaBlocks;        // superblock, gdt, bitmaps, inode table at the start of each group
+    uint32_t nextBlock;         // allocation cursor
+    uint8_t *blockBitmap;       // whole filesystem, one bit per block after firstDataBlock
+};
+
+uint32_t groupStart(const struct genLayout *layout, uint32_t group) {
+    return layout->firstDataBlock + group * layout->blocksPerGroup;
+}
+
+void markBlock(struct genLayout *layout, uint32_t blockNum) {
+    uint32_t index = blockNum - layout->firstDataBlock;
+    layout->blockBitmap[index / 8] |= 1 << (index % 8);
+}
+
+void unmarkBlock(struct genLayout *layout, uint32_t blockNum) {
+    uint32_t index = blockNum - layout->firstDataBlock;
+    layout->blockBitmap[index / 8] &= ~(1 << (index % 8));
+}
+
+// next free data block, group metadata is stepped over
+uint32_t allocateBlock(struct genLayout *layout) {
+
+    uint32_t offset = (layout->nextBlock - layout->firstDataBlock) % layout->blocksPerGroup;
+    if (offset < layout->metaBlocks) {
+        layout->nextBlock += layout->metaBlocks - offset;
+    }
+
+    uint32_t blockNum = layout->nextBlock++;
+    markBlock(layout, blockNum);
+    return blockNum;
+}
+
+void planLayout(struct genLayout *layout, const struct genConfig *config) {
+
+    memset(layout, 0, sizeof(*layout));
+    layout->blockSize = config->blockSize;
+    layout->firstDataBlock = config->blockSize == 1024 ? 1 : 0;
+    layout->blocksPerGroup = 8 * config->blockSize;
+    layout->inodesPerGroup = config->inodesPerGroup;
+    layout->inodeTableBlocks = layout->inodesPerGroup * EXT2_INODE_SIZE / config->blockSize;
+
+    uint32_t pointersPerBlock = config->blockSize / sizeof(uint32_t);
+    uint64_t dataBlocks = 0;
+    for (uint32_t ii = 0; ii < entryTotal; ii++) {
+        if (entries[ii].isDirectory) {
+            dataBlocks += entries[ii].blockCount + indirectBlocksFor(entries[ii].blockCount, pointersPerBlock);
+        }
+    }
+
+    uint32_t highestInode = entries[entryTotal - 1].inodeNum;
+    layout->groupCount = (highestInode + layout->inodesPerGroup - 1) / layout->inodesPerGroup;
+
+    // grow until every group's metadata plus all data fits
+    while (1) {
+        layout->gdtBlocks = (layout->groupCount * sizeof(struct ext2_block_group_descriptor) + config->blockSize - 1) / config->blockSize;
+        layout->metaBlocks = 1 + layout->gdtBlocks + 2 + layout->inodeTableBlocks;
+
+        if (layout->metaBlocks >= layout->blocksPerGroup) {
+            fprintf(stderr, "inodes per group too large for the block size\n");
+            exit(1);
+        }
+        if ((uint64_t)layout->groupCount * (layout->blocksPerGroup - layout->metaBlocks) >= dataBlocks) {
+            break;
+        }
+        layout->groupCount++;
+    }
+
+    layout->blockBitmap = calloc(layout->groupCount, layout->blocksPerGroup / 8);
+    for (uint32_t group = 0; group < layout->groupCount; group++) {
+        for (uint32_t ii = 0; ii < layout->metaBlocks; ii++) {
+            markBlock(layout, groupStart(layout, group) + ii);
+        }
+    }
+    layout->nextBlock = groupStart(layout, 0);
+}
+
+// give every directory its blocks and write them
+void placeDirectories(struct genLayout *layout, int fd) {
+
+    uint32_t blockSize = layout->blockSize;
+    uint32_t pointersPerBlock = blockSize / sizeof(uint32_t);
+    uint32_t *pointers = malloc(blockSize);
+    uint32_t *doublePointers = malloc(blockSize);
+
+    for (uint32_t ii = 0; ii < entryTotal; ii++) {
+        struct genEntry *dir = &entries[ii];
+        if (!dir->isDirectory) {
+            continue;
+        }
+
+        uint32_t done = 0;
+        uint32_t firstBlock = layout->nextBlock;
+
+        for (; done < dir->blockCount && done < EXT2_NUM_DIRECT_BLOCKS; done++) {
+            dir->blockNums[done] = allocateBlock(layout);
+            pwrite(fd, dir->blocks + (size_t)done * blockSize, blockSize, (off_t)dir->blockNums[done] * blockSize);
+        }
+
+        // single indirect
+        if (done < dir->blockCount) {
+            uint32_t indirect = allocateBlock(layout);
+            dir->blockNums[EXT2_NUM_DIRECT_BLOCKS] = indirect;
+            memset(pointers, 0, blockSize);
+
+            for (uint32_t jj = 0; jj < pointersPerBlock && done < dir->blockCount; jj++, done++) {
+                pointers[jj] = allocateBlock(layout);
+                pwrite(fd, dir->blocks + (size_t)done * blockSize, blockSize, (off_t)pointers[jj] * blockSize);
+            }
+            pwrite(fd, pointers, blockSize, (off_t)indirect * blockSize);
+        }
+
+        // double indirect
+        if (done < dir->blockCount) {
+            uint32_t doubleIndirect = allocateBlock(layout);
+            dir->blockNums[EXT2_NUM_DIRECT_BLOCKS + 1] = doubleIndirect;
+            memset(doublePointers, 0, blockSize);
+
+            for (uint32_t kk = 0; kk < pointersPerBlock && done < dir->blockCount; kk++) {
+                uint32_t indirect = allocateBlock(layout);
+                doublePointers[kk] = indirect;
+                memset(pointers, 0, blockSize);
+
+                for (uint32_t jj = 0; jj < pointersPerBlock && done < dir->blockCount; jj++, done++) {
+                    pointers[jj] = allocateBlock(layout);
+                    pwrite(fd, dir->blocks + (size_t)done * blockSize, blockSize, (off_t)pointers[jj] * blockSize);
+                }
+                pwrite(fd, pointers, blockSize, (off_t)indirect * blockSize);
+            }
+            pwrite(fd, doublePointers, blockSize, (off_t)doubleIndirect * blockSize);
+        }
+
+        // removed directory: blocks are free again but still hold its entries
+        if (dir->deleted) {
+            for (uint32_t blockNum = firstBlock; blockNum < layout->nextBlock; blockNum++) {
+                if ((blockNum - layout->firstDataBlock) % layout->blocksPerGroup >= layout->metaBlocks) {
+                    unmarkBlock(layout, blockNum);
+                }
+            }
+        }
+
+        free(dir->blocks);
+        dir->blocks = NULL;
+    }
+
+    free(pointers);
+    free(doublePointers);
+}
+
+// inode tables, bitmaps, descriptors and superblocks
+void writeMetadata(struct genLayout *layout, int fd) {
+
+    uint32_t blockSize = layout->blockSize;
+    uint32_t inodeCount = layout->groupCount * layout->inodesPerGroup;
+    uint32_t pointersPerBlock = blockSize / sizeof(uint32_t);
+
+    char *inodeTable = calloc((size_t)inodeCount, EXT2_INODE_SIZE);
+    uint8_t *inodeBitmap = calloc(layout->groupCount, blockSize);
+
+    // reserved inodes 1 to 10 are in use
+    for (uint32_t inodeNum = 1; inodeNum <= 10; inodeNum++) {
+        inodeBitmap[(inodeNum - 1) / layout->inodesPerGroup * blockSize + (inodeNum - 1) % layout->inodesPerGroup / 8] |= 1 << ((inodeNum - 1) % 8);
+    }
+
+    for (uint32_t ii = 0; ii < entryTotal; ii++) {
+        struct genEntry *entry = &entries[ii];
+        struct ext2_inode *inode = (struct ext2_inode *)(inodeTable + (size_t)(entry->inodeNum - 1) * EXT2_INODE_SIZE);
+
+        inode->mode = entry->isDirectory ? EXT2_I_DTYPE | EXT2_I_DPERM : EXT2_I_FTYPE | EXT2_I_FPERM;
+        inode->uid = EXT2_I_UID;
+        inode->gid = EXT2_I_GID;
+        inode->access_time = entry->createTime;
+        inode->change_time = entry->deleted ? entry->deleteTime : entry->createTime;
+        inode->modification_time = entry->deleted ? entry->deleteTime : entry->createTime;
+        inode->deletion_time = entry->deleteTime;
+
+        if (entry->isDirectory) {
+            inode->size = entry->blockCount * blockSize;
+            inode->link_count = entry->deleted ? 0 : 2 + entry->subdirCount;
+            uint32_t allBlocks = entry->blockCount + indirectBlocksFor(entry->blockCount, pointersPerBlock);
+            inode->block_count_512 = allBlocks * (blockSize / 512);
+
+            for (int jj = 0; jj < EXT2_NUM_DIRECT_BLOCKS; jj++) {
+                inode->direct_blocks[jj] = entry->blockNums[jj];
+            }
+            inode->single_indirect = entry->blockNums[EXT2_NUM_DIRECT_BLOCKS];
+            inode->double_indirect = entry->blockNums[EXT2_NUM_DIRECT_BLOCKS + 1];
+        }
+        else {
+            inode->link_count = entry->deleted ? 0 : 1;
+        }
+
+        if (!entry->deleted) {
+            uint32_t group = (entry->inodeNum - 1) / layout->inodesPerGroup;
+            uint32_t index = (entry->inodeNum - 1) % layout->inodesPerGroup;
+            inodeBitmap[group * blockSize + index / 8] |= 1 << (index % 8);
+        }
+    }
+
+    struct ext2_super_block superBlock;
+    memset(&superBlock, 0, sizeof(superBlock));
+    superBlock.inode_count = inodeCount;
+    superBlock.block_count = layout->firstDataBlock + layout->groupCount * layout->blocksPerGroup;
+    superBlock.first_data_block = layout->firstDataBlock;
+    superBlock.log_block_size = blockSize == 1024 ? 0 : blockSize == 2048 ? 1 : 2;
+    superBlock.log_fragment_size = superBlock.log_block_size;
+    superBlock.blocks_per_group = layout->blocksPerGroup;
+    superBlock.fragments_per_group = layout->blocksPerGroup;
+    superBlock.inodes_per_group = layout->inodesPerGroup;
+    superBlock.write_time = BASE_TIME;
+    superBlock.max_mount_count = 0xFFFF;
+    superBlock.magic = EXT2_SUPER_MAGIC;
+    superBlock.state = 1;
+    superBlock.errors = 1;
+    superBlock.rev_level = 1;
+    superBlock.first_inode = 11;
+    superBlock.inode_size = EXT2_INODE_SIZE;
+    superBlock.feature_incompat = 0x0002;    // filetype in directory entries
+
+    struct ext2_block_group_descriptor *descriptors = calloc(layout->groupCount, sizeof(struct ext2_block_group_descriptor));
+    uint32_t freeBlocks = 0;
+    uint32_t freeInodes = 0;
+
+    for (uint32_t group = 0; group < layout->groupCount; group++) {
+        uint32_t start = groupStart(layout, group);
+        struct ext2_block_group_descriptor *descriptor = &descriptors[group];
+
+        descriptor->block_bitmap = start + 1 + layout->gdtBlocks;
+        descriptor->inode_bitmap = descriptor->block_bitmap + 1;
+        descriptor->inode_table = descriptor->inode_bitmap + 1;
+
+        uint8_t *groupBlocks = layout->blockBitmap + (size_t)group * layout->blocksPerGroup / 8;
+        uint8_t *groupInodes = inodeBitmap + (size_t)group * blockSize;
+
+        for (uint32_t ii = 0; ii < layout->blocksPerGroup; ii++) {
+            descriptor->free_block_count += !((groupBlocks[ii / 8] >> (ii % 8)) & 1);
+        }
+        for (uint32_t ii = 0; ii < layout->inodesPerGroup; ii++) {
+            descriptor->free_inode_count += !((groupInodes[ii / 8] >> (ii % 8)) & 1);
+        }
+        // bits past the last inode of the group are set
+        for (uint32_t ii = layout->inodesPerGroup; ii < blockSize * 8; ii++) {
+            groupInodes[ii / 8] |= 1 << (ii % 8);
+        }
+
+        freeBlocks += descriptor->free_block_count;
+        freeInodes += descriptor->free_inode_count;
+
+        pwrite(fd, groupBlocks, blockSize, (off_t)descriptor->block_bitmap * blockSize);
+        pwrite(fd, groupInodes, blockSize, (off_t)descriptor->inode_bitmap * blockSize);
+        pwrite(fd, inodeTable + (size_t)group * layout->inodesPerGroup * EXT2_INODE_SIZE,
+               (size_t)layout->inodeTableBlocks * blockSize, (off_t)descriptor->inode_table * blockSize);
+    }
+
+    for (uint32_t ii = 0; ii < entryTotal; ii++) {
+        if (entries[ii].isDirectory && !entries[ii].deleted) {
+            uint32_t group = (entries[ii].inodeNum - 1) / layout->inodesPerGroup;
+            descriptors[group].used_dirs_count++;
+        }
+    }
+
+    superBlock.free_block_count = freeBlocks;
+    superBlock.free_inode_count = freeInodes;
+
+    // superblock and descriptor copy in every group
+    for (uint32_t group = 0; group < layout->groupCount; group++) {
+        uint32_t start = groupStart(layout, group);
+        off_t superPos = group == 0 ? EXT2_SUPER_BLOCK_POSITION : (off_t)start * blockSize;
+
+        superBlock.block_group_nr = group;
+        pwrite(fd, &superBlock, sizeof(superBlock), superPos);
+        pwrite(fd, descriptors, layout->groupCount * sizeof(struct ext2_block_group_descriptor), (off_t)(start + 1) * blockSize);
+    }
+
+    free(descriptors);
+    free(inodeBitmap);
+    free(inodeTable);
+}
+
+void usage(const char *program) {
+    fprintf(stderr,
+        "usage: %s [options] image\n"
+        "  --inodes N           files and directories to create (default 10000)\n"
+        "  --depth N            directory depth (default 4)\n"
+        "  --fanout N           entries per directory (default 32)\n"
+        "  --delete-rate R      fraction of files deleted (default 0.1)\n"
+        "  --rmdir-rate R       fraction of directories removed with their contents (default 0)\n"
+        "  --ghost-density R    fraction of deleted entries left readable (default 0.8)\n"
+        "  --corrupt-rate R     fraction of live entries pointing past the inode table (default 0)\n"
+        "  --block-size N       1024, 2048 or 4096 (default 1024)\n"
+        "  --inodes-per-group N (default 2048)\n"
+        "  --seed N             (default 1)\n", program);
+}
+
+int main(int argc, char *argv[]) {
+
+    struct genConfig config = {10000, 4, 32, 0.1, 0, 0.8, 0, 1024, 2048, 1};
+    const char *image = NULL;
+
+    for (int ii = 1; ii < argc; ii++) {
+        const char *value = ii + 1 < argc ? argv[ii + 1] : NULL;
+
+        if (strcmp(argv[ii], "--inodes") == 0 && value) {
+            config.entryCount = strtoul(value, NULL, 10);
+        }
+        else if (strcmp(argv[ii], "--depth") == 0 && value) {
+            config.depth = strtoul(value, NULL, 10);
+        }
+        else if (strcmp(argv[ii], "--fanout") == 0 && value) {
+            config.fanout = strtoul(value, NULL, 10);
+        }
+        else if (strcmp(argv[ii], "--delete-rate") == 0 && value) {
+            config.deleteRate = atof(value);
+        }
+        else if (strcmp(argv[ii], "--rmdir-rate") == 0 && value) {
+            config.rmdirRate = atof(value);
+        }
+        else if (strcmp(argv[ii], "--ghost-density") == 0 && value) {
+            config.ghostDensity = atof(value);
+        }
+        else if (strcmp(argv[ii], "--corrupt-rate") == 0 && value) {
+            config.corruptRate = atof(value);
+        }
+        else if (strcmp(argv[ii], "--block-size") == 0 && value) {
+            config.blockSize = strtoul(value, NULL, 10);
+        }
+        else if (strcmp(argv[ii], "--inodes-per-group") == 0 && value) {
+            config.inodesPerGroup = strtoul(value, NULL, 10);
+        }
+        else if (strcmp(argv[ii], "--seed") == 0 && value) {
+            config.seed = strtoull(value, NULL, 10);
+        }
+        else if (argv[ii][0] != '-' && image == NULL) {
+            image = argv[ii];
+            continue;
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+        ii++;
+    }
+
+    if (image == NULL || config.fanout == 0 || config.depth == 0 ||
+        (config.blockSize != 1024 && config.blockSize != 2048 && config.blockSize != 4096) ||
+        config.inodesPerGroup == 0 || config.inodesPerGroup > 8 * config.blockSize ||
+        config.inodesPerGroup * EXT2_INODE_SIZE % config.blockSize != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    randomState = config.seed ? config.seed : 1;
+
+    buildTree(&config);
+    packDirectories(config.blockSize);
+
+    struct genLayout layout;
+    planLayout(&layout, &config);
+
+    int fd = open(image, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(image);
+        return 1;
+    }
+    if (ftruncate(fd, (off_t)(layout.firstDataBlock + layout.groupCount * layout.blocksPerGroup) * config.blockSize) < 0) {
+        perror("ftruncate");
+        return 1;
+    }
+
+    placeDirectories(&layout, fd);
+    writeMetadata(&layout, fd);
+
+    close(fd);
+    free(layout.blockBitmap);
+    free(entries);
+
+    printf("%s: %u entries, %u groups, %u blocks of %u bytes\n", image, entryTotal - 2,
+           layout.groupCount, layout.firstDataBlock + layout.groupCount * layout.blocksPerGroup, config.blockSize);
+    return 0;
+}